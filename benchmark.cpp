@@ -0,0 +1,155 @@
+#include "benchmark.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+#include <glm/ext/scalar_constants.hpp>
+
+namespace
+{
+
+// Frames at the start of every shot that are rendered but not measured.
+const int warmup_frames = 10;
+
+}
+
+Benchmark::Benchmark(int frames_per_shot, std::string description, bool compare_water_prepass, bool compare_vertex_formats,
+    int compare_msaa_samples)
+    : description_(std::move(description))
+    , frames_per_shot_(frames_per_shot + warmup_frames)
+{
+    shots_ = {
+        {"overview", {20.f, 10.f, 20.f}, 0.f, 0.f},
+        {"grazing", {-1.f, 6.f, 4.f}, 0.15f, glm::pi<float>() / 2.f},
+        {"top-down", {20.f, 25.f, 4.f}, 1.4f, 0.f},
+        {"sky", {20.f, 10.f, 20.f}, -0.6f, 2.5f},
+    };
+    if (compare_water_prepass) {
+        std::vector<BenchmarkShot> shots;
+        for (auto const & shot : shots_) {
+            shots.push_back(shot);
+            shots.back().name += " +z";
+            shots.back().water_prepass = true;
+            shots.push_back(shot);
+            shots.back().name += " -z";
+            shots.back().water_prepass = false;
+        }
+        shots_ = std::move(shots);
+    }
+    if (compare_vertex_formats) {
+        std::vector<BenchmarkShot> shots;
+        for (auto const & shot : shots_) {
+            shots.push_back(shot);
+            shots.back().name += " pk";
+            shots.back().packed_vertices = true;
+            shots.push_back(shot);
+            shots.back().name += " f32";
+            shots.back().packed_vertices = false;
+        }
+        shots_ = std::move(shots);
+    }
+    if (compare_msaa_samples > 0) {
+        std::vector<BenchmarkShot> shots;
+        for (auto const & shot : shots_) {
+            shots.push_back(shot);
+            shots.back().name += " noaa";
+            shots.back().fxaa = false;
+            shots.back().msaa_samples = 1;
+            shots.push_back(shot);
+            shots.back().name += " fxaa";
+            shots.back().fxaa = true;
+            shots.back().msaa_samples = 1;
+            shots.push_back(shot);
+            shots.back().name += " " + std::to_string(compare_msaa_samples) + "x";
+            shots.back().fxaa = false;
+            shots.back().msaa_samples = compare_msaa_samples;
+        }
+        shots_ = std::move(shots);
+    }
+    stats_.resize(shots_.size());
+}
+
+void Benchmark::add_frame(long long timer_frame, double cpu_milliseconds, const GlState::Counters & state_calls, std::size_t vertex_fetch_bytes,
+    long long rendered_pixels)
+{
+    int shot = frame_ / frames_per_shot_;
+    if (frame_ % frames_per_shot_ >= warmup_frames) {
+        timer_frame_shot_[timer_frame] = shot;
+        timer_frame_pixels_[timer_frame] = rendered_pixels;
+        stats_[shot].frames += 1;
+        stats_[shot].cpu_milliseconds += cpu_milliseconds;
+        stats_[shot].state_calls_issued += state_calls.issued;
+        stats_[shot].state_calls_elided += state_calls.elided;
+        stats_[shot].vertex_fetch_bytes += vertex_fetch_bytes;
+    }
+    ++frame_;
+}
+
+void Benchmark::add_gpu_results(const std::vector<GpuTimer::Result> & results)
+{
+    for (auto const & result : results) {
+        auto it = timer_frame_shot_.find(result.frame);
+        if (it == timer_frame_shot_.end())
+            continue;
+        auto & stats = stats_[it->second];
+        stats.pass_milliseconds[result.name] += result.milliseconds;
+        stats.frame_gpu_milliseconds[result.frame] += result.milliseconds;
+        if (std::find(pass_names_.begin(), pass_names_.end(), result.name) == pass_names_.end())
+            pass_names_.push_back(result.name);
+    }
+}
+
+void Benchmark::add_sample_results(const std::vector<QueryScopes::Result> & results)
+{
+    for (auto const & result : results) {
+        auto it = timer_frame_shot_.find(result.frame);
+        if (it != timer_frame_shot_.end())
+            stats_[it->second].frame_overdraw[result.frame] += double(result.value) / timer_frame_pixels_.at(result.frame);
+    }
+}
+
+void Benchmark::report(std::ostream & out) const
+{
+    out << "Benchmark: " << description_ << ", " << frames_per_shot_ - warmup_frames << " frames per shot" << std::endl;
+    out << std::left << std::setw(16) << "shot" << std::right << std::setw(10) << "cpu ms" << std::setw(10) << "gpu ms" << std::setw(10) << "gpu p50"
+        << std::setw(10) << "gl state" << std::setw(10) << "elided" << std::setw(10) << "overdraw" << std::setw(10) << "vtx KB";
+    for (auto const & name : pass_names_)
+        out << std::setw(12) << name;
+    out << std::endl;
+
+    out << std::fixed << std::setprecision(3);
+    for (std::size_t i = 0; i < shots_.size(); ++i) {
+        auto const & stats = stats_[i];
+        int frames = std::max(1, stats.frames);
+
+        std::vector<double> gpu_frames;
+        for (auto const & [frame, milliseconds] : stats.frame_gpu_milliseconds)
+            gpu_frames.push_back(milliseconds);
+        double gpu_total = 0.0;
+        for (double milliseconds : gpu_frames)
+            gpu_total += milliseconds;
+        double overdraw = 0.0;
+        for (auto const & [frame, fragments_per_pixel] : stats.frame_overdraw)
+            overdraw += fragments_per_pixel / stats.frame_overdraw.size();
+        double gpu_median = 0.0;
+        if (!gpu_frames.empty()) {
+            std::nth_element(gpu_frames.begin(), gpu_frames.begin() + gpu_frames.size() / 2, gpu_frames.end());
+            gpu_median = gpu_frames[gpu_frames.size() / 2];
+        }
+
+        out << std::left << std::setw(16) << shots_[i].name << std::right
+            << std::setw(10) << stats.cpu_milliseconds / frames
+            << std::setw(10) << gpu_total / std::max<std::size_t>(1, gpu_frames.size())
+            << std::setw(10) << gpu_median
+            << std::setw(10) << stats.state_calls_issued / frames
+            << std::setw(10) << stats.state_calls_elided / frames
+            << std::setw(10) << overdraw
+            << std::setw(10) << stats.vertex_fetch_bytes / frames / 1024.0;
+        for (auto const & name : pass_names_) {
+            auto it = stats.pass_milliseconds.find(name);
+            out << std::setw(12) << (it == stats.pass_milliseconds.end() ? 0.0 : it->second / frames);
+        }
+        out << std::endl;
+    }
+    out << std::defaultfloat;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "gl_state.hpp"
+#include "gpu_timer.hpp"
+#include "query_scopes.hpp"
+
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <map>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct BenchmarkShot {
+    std::string name;
+    glm::vec3 camera_position;
+    float view_angle;
+    float camera_rotation;
+    // Overrides --no-water-prepass for this shot.
+    std::optional<bool> water_prepass;
+    // Overrides --float-vertices for this shot.
+    std::optional<bool> packed_vertices;
+    // Override --fxaa and --msaa for this shot.
+    std::optional<bool> fxaa;
+    std::optional<int> msaa_samples;
+};
+
+// Fixed camera path with a fixed time step. Each shot is rendered for a number of frames
+// and the CPU frame time and GPU time of every timed pass are averaged per shot.
+class Benchmark
+{
+public:
+    // With compare_water_prepass every shot is rendered once with and once without the water
+    // depth pre-pass, with compare_vertex_formats once with packed and once with float vertices,
+    // with compare_msaa_samples above 0 once without anti-aliasing, once with FXAA and once
+    // with that many samples.
+    Benchmark(int frames_per_shot, std::string description, bool compare_water_prepass = false, bool compare_vertex_formats = false,
+        int compare_msaa_samples = 0);
+
+    bool finished() const { return frame_ >= frames_per_shot_ * int(shots_.size()); }
+    const BenchmarkShot & shot() const { return shots_[frame_ / frames_per_shot_]; }
+    float time_step() const { return 1.f / 60.f; }
+
+    // Called once per rendered frame with the GpuTimer frame it was submitted as, the state
+    // changes the frame made, the vertex data its draws fetched and the pixels it rendered,
+    // which dynamic resolution makes fewer than the window's.
+    void add_frame(long long timer_frame, double cpu_milliseconds, const GlState::Counters & state_calls, std::size_t vertex_fetch_bytes,
+        long long rendered_pixels);
+    void add_gpu_results(const std::vector<GpuTimer::Result> & results);
+    // Samples shaded in the scene passes, reported as fragments per pixel rendered in the frame
+    // each was counted in (overdraw).
+    void add_sample_results(const std::vector<QueryScopes::Result> & results);
+
+    void report(std::ostream & out) const;
+
+private:
+    struct ShotStats {
+        int frames = 0;
+        double cpu_milliseconds = 0.0;
+        long long state_calls_issued = 0;
+        long long state_calls_elided = 0;
+        double vertex_fetch_bytes = 0.0;
+        std::map<std::string, double> pass_milliseconds;
+        std::map<long long, double> frame_gpu_milliseconds;
+        std::map<long long, double> frame_overdraw;
+    };
+
+    std::vector<BenchmarkShot> shots_;
+    std::vector<ShotStats> stats_;
+    std::map<long long, int> timer_frame_shot_;
+    std::map<long long, long long> timer_frame_pixels_;
+    std::vector<std::string> pass_names_;
+    std::string description_;
+    int frames_per_shot_;
+    int frame_ = 0;
+};
@@ -0,0 +1,21 @@
+# Embeds every file of SHADER_DIR into the OUTPUT header as raw string literals, so that the
+# executable still has its shaders when it runs without the source tree.
+#
+# Usage: cmake -DSHADER_DIR=<dir> -DOUTPUT=<header> -P embed_shaders.cmake
+
+file(GLOB shader_files RELATIVE "${SHADER_DIR}" "${SHADER_DIR}/*")
+list(SORT shader_files)
+
+set(content "// Generated from ${SHADER_DIR} by cmake/embed_shaders.cmake, do not edit.\n")
+string(APPEND content "#pragma once\n\n#include <map>\n#include <string_view>\n\n")
+string(APPEND content "inline const std::map<std::string_view, std::string_view> embedded_shaders = {\n")
+foreach(name ${shader_files})
+	file(READ "${SHADER_DIR}/${name}" source)
+	string(APPEND content "    {\"${name}\", R\"glsl(${source})glsl\"},\n")
+endforeach()
+string(APPEND content "};\n")
+
+# Only touch the header when something changed to avoid needless recompilation.
+file(WRITE "${OUTPUT}.tmp" "${content}")
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy_if_different "${OUTPUT}.tmp" "${OUTPUT}")
+file(REMOVE "${OUTPUT}.tmp")
@@ -0,0 +1,58 @@
+#include "dynamic_resolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+// Only scale up when the frame is clearly below the budget, otherwise the scale oscillates
+// around the point where the budget is just met.
+const double headroom = 0.85;
+// Fraction of the way towards the estimated scale taken per measured frame.
+const float damping = 0.25f;
+
+}
+
+DynamicResolution::DynamicResolution(double budget_milliseconds, float min_scale, float max_scale)
+    : budget_(budget_milliseconds)
+    , min_scale_(min_scale)
+    , max_scale_(max_scale)
+    , scale_(max_scale)
+{}
+
+void DynamicResolution::add_gpu_results(const std::vector<GpuTimer::Result> & results)
+{
+    // Results arrive in submission order, so a frame is complete once the next one shows up.
+    for (auto const & result : results) {
+        if (result.frame != frame_) {
+            if (frame_ >= 0)
+                frame_finished(frame_milliseconds_);
+            frame_ = result.frame;
+            frame_milliseconds_ = 0.0;
+        }
+        frame_milliseconds_ += result.milliseconds;
+    }
+}
+
+void DynamicResolution::frame_finished(double milliseconds)
+{
+    if (milliseconds <= 0.0)
+        return;
+    if (milliseconds < budget_ && milliseconds > budget_ * headroom)
+        return;
+
+    // GPU time is roughly proportional to the pixel count, i.e. to the square of the scale.
+    float target = scale_ * float(std::sqrt(budget_ * headroom / milliseconds));
+    target = std::clamp(target, min_scale_, max_scale_);
+    scale_ += (target - scale_) * damping;
+    if (std::abs(scale_ - target) < 0.01f)
+        scale_ = target;
+}
+
+int DynamicResolution::scaled(int size) const
+{
+    if (scale_ >= 1.f)
+        return size;
+    return std::max(8, int(size * scale_) / 8 * 8);
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "gpu_timer.hpp"
+
+#include <vector>
+
+// Picks the fraction of the window resolution the scene is rendered at from the measured GPU
+// frame time, so that the frame time stays within a budget. The scale applies to both axes.
+class DynamicResolution
+{
+public:
+    DynamicResolution(double budget_milliseconds, float min_scale = 0.5f, float max_scale = 1.f);
+
+    // Feeds GpuTimer results; the scale changes once a whole frame has been measured.
+    void add_gpu_results(const std::vector<GpuTimer::Result> & results);
+
+    float scale() const { return scale_; }
+    double budget() const { return budget_; }
+
+    // Render size for a window size, rounded to multiples of 8 pixels so that small scale
+    // changes don't produce a new size every frame.
+    int scaled(int size) const;
+
+private:
+    void frame_finished(double milliseconds);
+
+    double budget_;
+    float min_scale_;
+    float max_scale_;
+    float scale_;
+    long long frame_ = -1;
+    double frame_milliseconds_ = 0.0;
+};
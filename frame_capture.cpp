@@ -0,0 +1,266 @@
+#include "frame_capture.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+namespace
+{
+
+// Pixel pack buffers in flight; a readback is mapped this many frames after it was issued.
+const int readback_slots = 3;
+// Converted frames waiting for the worker before capture_frame blocks.
+const std::size_t max_queued_frames = 4;
+
+unsigned char luma(int r, int g, int b)
+{
+    return ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+}
+
+// Chroma of the sums of a 2x2 block.
+unsigned char chroma_u(int r, int g, int b)
+{
+    r = (r + 2) >> 2, g = (g + 2) >> 2, b = (b + 2) >> 2;
+    return ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+}
+
+unsigned char chroma_v(int r, int g, int b)
+{
+    r = (r + 2) >> 2, g = (g + 2) >> 2, b = (b + 2) >> 2;
+    return ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+}
+
+#ifdef __SSE2__
+
+// 8 RGBA pixels to R, G and B in 16-bit lanes.
+void split_channels(const unsigned char * pixels, __m128i & r, __m128i & g, __m128i & b)
+{
+    __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels));
+    __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + 16));
+    __m128i mask = _mm_set1_epi32(0xff);
+    r = _mm_packs_epi32(_mm_and_si128(low, mask), _mm_and_si128(high, mask));
+    g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(low, 8), mask), _mm_and_si128(_mm_srli_epi32(high, 8), mask));
+    b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(low, 16), mask), _mm_and_si128(_mm_srli_epi32(high, 16), mask));
+}
+
+// The weighted sum fits in 16 unsigned bits, so it's computed with wrapping 16-bit arithmetic
+// and a logical shift.
+void store_luma(__m128i r, __m128i g, __m128i b, unsigned char * out)
+{
+    __m128i y = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)), _mm_mullo_epi16(g, _mm_set1_epi16(129)));
+    y = _mm_add_epi16(y, _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(25)), _mm_set1_epi16(128)));
+    y = _mm_add_epi16(_mm_srli_epi16(y, 8), _mm_set1_epi16(16));
+    _mm_storel_epi64(reinterpret_cast<__m128i *>(out), _mm_packus_epi16(y, y));
+}
+
+// Averages of the 2x2 blocks of two rows of 8 pixels, in the low 4 lanes.
+__m128i block_average(__m128i row0, __m128i row1)
+{
+    __m128i sums = _mm_madd_epi16(_mm_add_epi16(row0, row1), _mm_set1_epi16(1));
+    return _mm_srli_epi16(_mm_add_epi16(_mm_packs_epi32(sums, sums), _mm_set1_epi16(2)), 2);
+}
+
+// Signed weights stay within 16 bits for 8-bit inputs.
+void store_chroma(__m128i r, __m128i g, __m128i b, short wr, short wg, short wb, unsigned char * out)
+{
+    __m128i c = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(wr)), _mm_mullo_epi16(g, _mm_set1_epi16(wg)));
+    c = _mm_add_epi16(c, _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(wb)), _mm_set1_epi16(128)));
+    c = _mm_add_epi16(_mm_srai_epi16(c, 8), _mm_set1_epi16(128));
+    int packed = _mm_cvtsi128_si32(_mm_packus_epi16(c, c));
+    std::memcpy(out, &packed, 4);
+}
+
+#endif
+
+}
+
+void rgba_to_i420(const unsigned char * rgba, int width, int height, unsigned char * yuv)
+{
+    unsigned char * y_plane = yuv;
+    unsigned char * u_plane = y_plane + width * height;
+    unsigned char * v_plane = u_plane + (width / 2) * (height / 2);
+
+    for (int y = 0; y < height; y += 2) {
+        // glReadPixels rows start at the bottom.
+        const unsigned char * row0 = rgba + std::size_t(height - 1 - y) * width * 4;
+        const unsigned char * row1 = row0 - std::size_t(width) * 4;
+        unsigned char * y_row0 = y_plane + std::size_t(y) * width;
+        unsigned char * y_row1 = y_row0 + width;
+        unsigned char * u_row = u_plane + std::size_t(y / 2) * (width / 2);
+        unsigned char * v_row = v_plane + std::size_t(y / 2) * (width / 2);
+
+        int x = 0;
+#ifdef __SSE2__
+        for (; x + 8 <= width; x += 8) {
+            __m128i r0, g0, b0, r1, g1, b1;
+            split_channels(row0 + x * 4, r0, g0, b0);
+            split_channels(row1 + x * 4, r1, g1, b1);
+            store_luma(r0, g0, b0, y_row0 + x);
+            store_luma(r1, g1, b1, y_row1 + x);
+
+            __m128i r = block_average(r0, r1);
+            __m128i g = block_average(g0, g1);
+            __m128i b = block_average(b0, b1);
+            store_chroma(r, g, b, -38, -74, 112, u_row + x / 2);
+            store_chroma(r, g, b, 112, -94, -18, v_row + x / 2);
+        }
+#endif
+        for (; x < width; x += 2) {
+            const unsigned char * p[4] = {row0 + x * 4, row0 + x * 4 + 4, row1 + x * 4, row1 + x * 4 + 4};
+            y_row0[x] = luma(p[0][0], p[0][1], p[0][2]);
+            y_row0[x + 1] = luma(p[1][0], p[1][1], p[1][2]);
+            y_row1[x] = luma(p[2][0], p[2][1], p[2][2]);
+            y_row1[x + 1] = luma(p[3][0], p[3][1], p[3][2]);
+
+            int r = p[0][0] + p[1][0] + p[2][0] + p[3][0];
+            int g = p[0][1] + p[1][1] + p[2][1] + p[3][1];
+            int b = p[0][2] + p[1][2] + p[2][2] + p[3][2];
+            u_row[x / 2] = chroma_u(r, g, b);
+            v_row[x / 2] = chroma_v(r, g, b);
+        }
+    }
+}
+
+FrameCapture::FrameCapture(const std::string & path, int width, int height, int fps, int frames)
+    // 4:2:0 chroma needs even dimensions.
+    : width_(width / 2 * 2)
+    , height_(height / 2 * 2)
+    , fps_(fps)
+    , frames_(frames)
+{
+    if (width_ <= 0 || height_ <= 0)
+        throw std::runtime_error("Can't capture an empty window");
+
+    pipe_ = !path.empty() && path[0] == '|';
+    file_ = pipe_ ? popen(path.c_str() + 1, "w") : std::fopen(path.c_str(), "wb");
+    if (!file_)
+        throw std::runtime_error("Can't open " + path + " for the capture");
+
+    std::string header = "YUV4MPEG2 W" + std::to_string(width_) + " H" + std::to_string(height_)
+        + " F" + std::to_string(fps_) + ":1 Ip A1:1 C420jpeg\n";
+    std::fwrite(header.data(), 1, header.size(), file_);
+
+    std::size_t size = std::size_t(width_) * height_ * 4;
+    slots_.resize(readback_slots);
+    for (auto & slot : slots_) {
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    worker_ = std::thread([this] { encode_frames(); });
+}
+
+FrameCapture::~FrameCapture()
+{
+    while (!pending_.empty())
+        collect_oldest();
+    {
+        std::lock_guard lock(mutex_);
+        closing_ = true;
+    }
+    queued_.notify_one();
+    worker_.join();
+
+    for (auto & slot : slots_)
+        glDeleteBuffers(1, &slot.buffer);
+    if (pipe_)
+        pclose(file_);
+    else
+        std::fclose(file_);
+}
+
+void FrameCapture::capture_frame()
+{
+    if (write_failed_)
+        throw std::runtime_error("Writing the capture failed");
+
+    // The slot is reused after readback_slots frames; by then the GPU has long finished it.
+    if (int(pending_.size()) == readback_slots)
+        collect_oldest();
+
+    auto & slot = slots_[next_slot_];
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glReadBuffer(GL_BACK);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    pending_.push_back(next_slot_);
+    next_slot_ = (next_slot_ + 1) % readback_slots;
+    ++captured_;
+
+    // Pick up whatever already finished without waiting.
+    while (!pending_.empty() && glClientWaitSync(slots_[pending_.front()].fence, 0, 0) != GL_TIMEOUT_EXPIRED)
+        collect_oldest();
+}
+
+void FrameCapture::collect_oldest()
+{
+    auto & slot = slots_[pending_.front()];
+    pending_.pop_front();
+    while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+        ;
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    std::vector<unsigned char> frame;
+    {
+        std::unique_lock lock(mutex_);
+        dequeued_.wait(lock, [this] { return queue_.size() < max_queued_frames; });
+        if (!free_frames_.empty()) {
+            frame = std::move(free_frames_.back());
+            free_frames_.pop_back();
+        }
+    }
+    frame.resize(std::size_t(width_) * height_ * 4);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (auto pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frame.size(), GL_MAP_READ_BIT)) {
+        std::memcpy(frame.data(), pixels, frame.size());
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    {
+        std::lock_guard lock(mutex_);
+        queue_.push_back(std::move(frame));
+    }
+    queued_.notify_one();
+}
+
+void FrameCapture::encode_frames()
+{
+    std::vector<unsigned char> yuv(std::size_t(width_) * height_ * 3 / 2);
+    for (;;) {
+        std::vector<unsigned char> frame;
+        {
+            std::unique_lock lock(mutex_);
+            queued_.wait(lock, [this] { return !queue_.empty() || closing_; });
+            if (queue_.empty())
+                return;
+            frame = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        dequeued_.notify_one();
+
+        rgba_to_i420(frame.data(), width_, height_, yuv.data());
+        static const char frame_header[] = "FRAME\n";
+        if (std::fwrite(frame_header, 1, sizeof(frame_header) - 1, file_) != sizeof(frame_header) - 1
+            || std::fwrite(yuv.data(), 1, yuv.size(), file_) != yuv.size())
+            write_failed_ = true;
+
+        std::lock_guard lock(mutex_);
+        free_frames_.push_back(std::move(frame));
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Converts bottom-up RGBA8 rows (as glReadPixels returns them) to top-down I420: a full
+// resolution Y plane followed by U and V at half resolution, BT.601 limited range. Width and
+// height must be even. Uses SSE2 where available.
+void rgba_to_i420(const unsigned char * rgba, int width, int height, unsigned char * yuv);
+
+// Records the default framebuffer to a Y4M video. Every frame is read back into a ring of
+// pixel pack buffers, so glReadPixels returns immediately and the pixels are only mapped a
+// couple of frames later when the GPU is done with them. A worker thread converts the frames
+// to YUV and writes them to a file, or to a command's standard input for a path starting
+// with '|' (e.g. "|ffmpeg -i - pool.mp4").
+class FrameCapture
+{
+public:
+    FrameCapture(const std::string & path, int width, int height, int fps, int frames);
+    // Writes the frames still in flight.
+    ~FrameCapture();
+
+    FrameCapture(const FrameCapture &) = delete;
+    FrameCapture & operator=(const FrameCapture &) = delete;
+
+    // Time of the next captured frame; capture runs at a fixed time step.
+    float time() const { return float(captured_) / fps_; }
+    bool finished() const { return captured_ >= frames_; }
+    int captured() const { return captured_; }
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    // Starts the readback of the lower left width x height pixels of the back buffer; call
+    // before swapping.
+    void capture_frame();
+
+private:
+    struct Slot {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+    };
+
+    void collect_oldest();
+    void encode_frames();
+
+    int width_;
+    int height_;
+    int fps_;
+    int frames_;
+    int captured_ = 0;
+    std::FILE * file_ = nullptr;
+    bool pipe_ = false;
+
+    std::vector<Slot> slots_;
+    std::deque<int> pending_;
+    int next_slot_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable queued_;
+    std::condition_variable dequeued_;
+    std::deque<std::vector<unsigned char>> queue_;
+    std::vector<std::vector<unsigned char>> free_frames_;
+    bool closing_ = false;
+    std::atomic<bool> write_failed_ = false;
+    std::thread worker_;
+};
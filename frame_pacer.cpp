@@ -0,0 +1,153 @@
+#include "frame_pacer.hpp"
+
+#ifdef WIN32
+#include <SDL.h>
+#else
+#include <SDL2/SDL.h>
+#endif
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace
+{
+
+// Sleeping is only accurate to a millisecond or two (more on Windows), the rest is spun.
+const std::chrono::microseconds spin_margin(1500);
+// Safety margin on the predicted frame time in low latency mode.
+const double latency_margin_milliseconds = 1.0;
+// Number of recent frames the prediction takes the maximum of.
+const std::size_t history_frames = 30;
+
+void precise_sleep_until(std::chrono::steady_clock::time_point deadline)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (deadline - now > spin_margin)
+        std::this_thread::sleep_for(deadline - now - spin_margin);
+    while (std::chrono::steady_clock::now() < deadline)
+        std::this_thread::yield();
+}
+
+void push_limited(std::deque<double> & history, double value)
+{
+    history.push_back(value);
+    if (history.size() > history_frames)
+        history.pop_front();
+}
+
+std::chrono::steady_clock::duration milliseconds(double value)
+{
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(value));
+}
+
+}
+
+VsyncMode parse_vsync_mode(std::string_view mode)
+{
+    if (mode == "on")
+        return VsyncMode::on;
+    if (mode == "off")
+        return VsyncMode::off;
+    if (mode == "adaptive")
+        return VsyncMode::adaptive;
+    throw std::runtime_error("Unknown vsync mode: " + std::string(mode));
+}
+
+FramePacer::FramePacer(const FramePacing & pacing)
+    : pacing_(pacing)
+    , vsync_(pacing.vsync)
+{
+    // Adaptive vsync (late swap tearing) isn't supported everywhere.
+    if (vsync_ == VsyncMode::adaptive && SDL_GL_SetSwapInterval(-1) != 0) {
+        std::cout << "Adaptive vsync is not supported, using vsync" << std::endl;
+        vsync_ = VsyncMode::on;
+    }
+    if (vsync_ != VsyncMode::adaptive)
+        SDL_GL_SetSwapInterval(vsync_ == VsyncMode::on ? 1 : 0);
+
+    frame_start_ = next_slot_ = last_present_ = Clock::now();
+}
+
+FramePacer::~FramePacer()
+{
+    for (GLsync fence : fences_)
+        glDeleteSync(fence);
+}
+
+double FramePacer::predicted_milliseconds() const
+{
+    double cpu = cpu_milliseconds_.empty() ? 0.0 : *std::max_element(cpu_milliseconds_.begin(), cpu_milliseconds_.end());
+    double gpu = gpu_milliseconds_.empty() ? 0.0 : *std::max_element(gpu_milliseconds_.begin(), gpu_milliseconds_.end());
+    return cpu + gpu + latency_margin_milliseconds;
+}
+
+void FramePacer::wait_for_frame_start()
+{
+    // The fence of the frame max_frames_ahead frames back has to be signaled.
+    while (!fences_.empty() && int(fences_.size()) >= pacing_.max_frames_ahead) {
+        GLsync fence = fences_.front();
+        fences_.pop_front();
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+            ;
+        glDeleteSync(fence);
+    }
+
+    auto now = Clock::now();
+    auto start = now;
+
+    // Frames start in slots of one cap period; a frame that ran late starts a new schedule.
+    std::optional<Clock::duration> period;
+    if (pacing_.fps_cap) {
+        period = milliseconds(1000.0 / *pacing_.fps_cap);
+        next_slot_ += *period;
+        if (next_slot_ < now - *period)
+            next_slot_ = now;
+        start = next_slot_;
+    }
+
+    if (pacing_.low_latency) {
+        // Finish the frame just before it's presented: at the end of the cap slot, or at the
+        // vblank after the previous present.
+        std::optional<Clock::time_point> present;
+        if (period)
+            present = next_slot_ + *period;
+        else if (vsync_ != VsyncMode::off)
+            present = last_present_ + milliseconds(1000.0 / std::max(1, pacing_.refresh_rate));
+        if (present)
+            start = std::max(start, *present - milliseconds(predicted_milliseconds()));
+    }
+
+    if (start > now)
+        precise_sleep_until(start);
+    frame_start_ = Clock::now();
+}
+
+void FramePacer::frame_submitted()
+{
+    push_limited(cpu_milliseconds_, std::chrono::duration<double, std::milli>(Clock::now() - frame_start_).count());
+}
+
+void FramePacer::frame_presented()
+{
+    last_present_ = Clock::now();
+    if (pacing_.max_frames_ahead <= 0)
+        glFinish();
+    else
+        fences_.push_back(glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0));
+}
+
+void FramePacer::add_gpu_results(const std::vector<GpuTimer::Result> & results)
+{
+    for (auto const & result : results) {
+        if (result.frame != gpu_frame_) {
+            if (gpu_frame_ >= 0)
+                push_limited(gpu_milliseconds_, gpu_frame_milliseconds_);
+            gpu_frame_ = result.frame;
+            gpu_frame_milliseconds_ = 0.0;
+        }
+        gpu_frame_milliseconds_ += result.milliseconds;
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "gpu_timer.hpp"
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <deque>
+#include <optional>
+#include <string_view>
+
+enum class VsyncMode { off, on, adaptive };
+
+// Parses "on", "off" or "adaptive".
+VsyncMode parse_vsync_mode(std::string_view mode);
+
+struct FramePacing {
+    VsyncMode vsync = VsyncMode::on;
+    // Upper limit on frames per second, enforced by the CPU.
+    std::optional<double> fps_cap;
+    // Starts every frame as late as the measured CPU and GPU times allow, so the frame shows
+    // input that is as recent as possible when it's presented.
+    bool low_latency = false;
+    // Frames the CPU may submit before the GPU finishes the oldest one; 0 waits for every frame
+    // with glFinish.
+    int max_frames_ahead = 2;
+    // Display refresh rate, used to predict when a vsynced frame is presented.
+    int refresh_rate = 60;
+};
+
+// Decides when the render thread starts a frame. Owns the swap interval of the current
+// context, so it's created on the thread that renders.
+class FramePacer
+{
+public:
+    explicit FramePacer(const FramePacing & pacing);
+    ~FramePacer();
+
+    FramePacer(const FramePacer &) = delete;
+    FramePacer & operator=(const FramePacer &) = delete;
+
+    // Blocks until the GPU is within max_frames_ahead and the frame cap and low latency mode
+    // allow the next frame to start.
+    void wait_for_frame_start();
+    // Call right before SDL_GL_SwapWindow and right after it returns.
+    void frame_submitted();
+    void frame_presented();
+    // Feeds GpuTimer results for the low latency prediction.
+    void add_gpu_results(const std::vector<GpuTimer::Result> & results);
+
+    // Swap interval that the driver accepted.
+    VsyncMode vsync() const { return vsync_; }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    double predicted_milliseconds() const;
+
+    FramePacing pacing_;
+    VsyncMode vsync_;
+    std::deque<GLsync> fences_;
+    Clock::time_point frame_start_;
+    Clock::time_point next_slot_;
+    Clock::time_point last_present_;
+    // Recent CPU submission and GPU times, newest last.
+    std::deque<double> cpu_milliseconds_;
+    std::deque<double> gpu_milliseconds_;
+    long long gpu_frame_ = -1;
+    double gpu_frame_milliseconds_ = 0.0;
+};
@@ -0,0 +1,121 @@
+#include "frame_snapshot.hpp"
+
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/scalar_constants.hpp>
+#include <glm/matrix.hpp>
+
+namespace
+{
+
+const glm::vec3 base_camera_front = glm::vec3(0.f, 0.f, -1.f);
+const glm::vec3 camera_up = glm::vec3(0.f, 1.f, 0.f);
+
+// Lengyel's oblique frustum: the near plane of projection becomes plane, given in view space
+// with the camera on its negative side. The far plane tilts along, depth stays in [-1, 1].
+glm::mat4 oblique_projection(glm::mat4 projection, const glm::vec4 & plane)
+{
+    // The far corner of the frustum opposite to the plane, in view space.
+    glm::vec4 corner = glm::inverse(projection) * glm::vec4(glm::sign(plane.x), glm::sign(plane.y), 1.f, 1.f);
+    glm::vec4 scaled = plane * (2.f / glm::dot(plane, corner));
+    for (int column = 0; column < 4; ++column)
+        projection[column][2] = scaled[column] - projection[column][3];
+    return projection;
+}
+
+float radical_inverse(int index, int base)
+{
+    float result = 0.f;
+    float digit_scale = 1.f / base;
+    for (; index > 0; index /= base, digit_scale /= base)
+        result += float(index % base) * digit_scale;
+    return result;
+}
+
+}
+
+glm::vec3 camera_front(const Camera & camera)
+{
+    glm::mat4 rotation_matrix(1.f);
+    rotation_matrix = glm::rotate(rotation_matrix, camera.view_angle, {1.f, 0.f, 0.f});
+    rotation_matrix = glm::rotate(rotation_matrix, camera.rotation, {0.f, 1.f, 0.f});
+    return base_camera_front * glm::mat3(rotation_matrix);
+}
+
+glm::mat4 camera_projection(int width, int height)
+{
+    float near = 0.01f;
+    float far = 100.0;
+    return glm::perspective(glm::pi<float>() / 2.f, (1.f * width) / height, near, far);
+}
+
+FrameSnapshot make_frame_snapshot(const Camera & camera, const SceneConfig & scene, float time, int width, int height)
+{
+    FrameSnapshot frame;
+    frame.width = width;
+    frame.height = height;
+    frame.time = time;
+    frame.camera_position = camera.position;
+    frame.view = glm::lookAt(camera.position, camera.position + camera_front(camera), camera_up);
+    frame.projection = camera_projection(width, height);
+
+    glm::mat4 env_rotation_matrix(1.f);
+    env_rotation_matrix = glm::rotate(env_rotation_matrix, -camera.view_angle, {1.f, 0.f, 0.f});
+    env_rotation_matrix = glm::rotate(env_rotation_matrix, -camera.rotation, {0.f, 1.f, 0.f});
+    glm::vec3 env_camera_front = base_camera_front * glm::mat3(env_rotation_matrix);
+    frame.env_view = glm::lookAt(glm::vec3(0), env_camera_front, camera_up);
+
+    frame.sun_direction = scene.sun_direction;
+    frame.sun_light = scene.sun_light;
+    frame.ambient_light = scene.ambient_light;
+    return frame;
+}
+
+FrameSnapshot mirror_frame(const FrameSnapshot & frame, float plane_height)
+{
+    glm::mat4 mirror(1.f);
+    mirror[1][1] = -1.f;
+    mirror[3][1] = 2.f * plane_height;
+
+    FrameSnapshot mirrored = frame;
+    mirrored.view = frame.view * mirror;
+    mirrored.camera_position = glm::vec3(mirror * glm::vec4(frame.camera_position, 1.f));
+    mirrored.env_view = frame.env_view * glm::mat4(glm::mat3(mirror));
+
+    // Keep the side of the plane the real camera is on, which is the other side from the
+    // mirrored one.
+    float side = frame.camera_position.y >= plane_height ? 1.f : -1.f;
+    glm::vec4 plane = side * glm::vec4(0.f, 1.f, 0.f, -plane_height);
+    mirrored.projection = oblique_projection(frame.projection, glm::transpose(glm::inverse(mirrored.view)) * plane);
+    return mirrored;
+}
+
+glm::vec2 halton_jitter(int index)
+{
+    // The sequence starts at 1, its 0th point is the corner.
+    int point = index % 8 + 1;
+    return glm::vec2(radical_inverse(point, 2), radical_inverse(point, 3)) - 0.5f;
+}
+
+glm::mat4 clip_offset(glm::vec2 offset)
+{
+    glm::mat4 transform(1.f);
+    transform[3][0] = offset.x;
+    transform[3][1] = offset.y;
+    return transform;
+}
+
+glm::mat4 tile_transform(int width, int height, int x0, int y0, int x1, int y1)
+{
+    // Scale about the tile centre in normalized device coordinates, applied in clip space.
+    float scale_x = float(width) / (x1 - x0);
+    float scale_y = float(height) / (y1 - y0);
+    float center_x = float(x0 + x1) / width - 1.f;
+    float center_y = float(y0 + y1) / height - 1.f;
+    glm::mat4 transform(1.f);
+    transform[0][0] = scale_x;
+    transform[1][1] = scale_y;
+    transform[3][0] = -scale_x * center_x;
+    transform[3][1] = -scale_y * center_y;
+    return transform;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "scene_config.hpp"
+
+struct Camera {
+    glm::vec3 position;
+    float view_angle = 0.f;
+    float rotation = 0.f;
+};
+
+// Unit vector the camera looks along.
+glm::vec3 camera_front(const Camera & camera);
+
+// Everything the render thread needs to draw one frame. The main thread integrates input into
+// a new snapshot every tick; a published snapshot is never modified.
+struct FrameSnapshot {
+    int width = 1;
+    int height = 1;
+    float time = 0.f;
+    glm::vec3 camera_position{0.f};
+    glm::mat4 view{1.f};
+    glm::mat4 projection{1.f};
+    glm::mat4 env_view{1.f};
+    glm::vec3 sun_direction{0.f, 1.f, 0.f};
+    glm::vec3 sun_light{1.f};
+    glm::vec3 ambient_light{0.f};
+};
+
+FrameSnapshot make_frame_snapshot(const Camera & camera, const SceneConfig & scene, float time, int width, int height);
+
+// Perspective projection of the camera for a width x height image.
+glm::mat4 camera_projection(int width, int height);
+
+// The frame seen in a mirror at y = plane_height: the view is reflected about the plane and
+// the near plane of the projection is replaced by the mirror, so only what is on the camera's
+// side of it is drawn.
+FrameSnapshot mirror_frame(const FrameSnapshot & frame, float plane_height);
+
+// Sub-pixel offset of frame `index` in pixels, within [-0.5, 0.5). The Halton (2, 3) sequence
+// repeats every 8 frames and covers the pixel evenly in any run of them.
+glm::vec2 halton_jitter(int index);
+
+// Moves the image by offset in normalized device coordinates when premultiplied to a projection
+// or to env_view, like tile_transform.
+glm::mat4 clip_offset(glm::vec2 offset);
+
+// Maps the pixels [x0, x1) x [y0, y1) of a width x height image (y up, as in GL) to the whole
+// viewport. Premultiplied to the projection it gives the off-centre frustum of that tile; the
+// sky, which env_view puts straight into clip space, is premultiplied the same way.
+glm::mat4 tile_transform(int width, int height, int x0, int y0, int x1, int y1);
@@ -0,0 +1,159 @@
+#include "gl_state.hpp"
+
+#include <limits>
+#include <stdexcept>
+
+namespace
+{
+
+int texture_target_index(GLenum target)
+{
+    switch (target) {
+    case GL_TEXTURE_2D:
+        return 0;
+    case GL_TEXTURE_CUBE_MAP:
+        return 1;
+    }
+    throw std::logic_error("GlState: untracked texture target");
+}
+
+int capability_index(GLenum capability)
+{
+    switch (capability) {
+    case GL_BLEND:
+        return 0;
+    case GL_DEPTH_TEST:
+        return 1;
+    case GL_CULL_FACE:
+        return 2;
+    }
+    throw std::logic_error("GlState: untracked capability");
+}
+
+}
+
+void GlState::invalidate()
+{
+    program_ = unknown;
+    vertex_array_ = unknown;
+    draw_framebuffer_ = unknown;
+    active_texture_unit_ = unknown;
+    for (auto & unit : textures_)
+        unit.fill(unknown);
+    capabilities_.fill(-1);
+    blend_func_.fill(unknown);
+    depth_func_ = unknown;
+    depth_mask_ = -1;
+    color_mask_ = -1;
+    viewport_.fill(-1);
+    // NaN never compares equal, so the first clear color is always issued.
+    clear_color_.fill(std::numeric_limits<float>::quiet_NaN());
+}
+
+bool GlState::changed(bool different)
+{
+    ++(different ? counters_.issued : counters_.elided);
+    return different;
+}
+
+void GlState::use_program(GLuint program)
+{
+    if (changed(program_ != program)) {
+        glUseProgram(program);
+        program_ = program;
+    }
+}
+
+void GlState::bind_vertex_array(GLuint vao)
+{
+    if (changed(vertex_array_ != vao)) {
+        glBindVertexArray(vao);
+        vertex_array_ = vao;
+    }
+}
+
+void GlState::bind_draw_framebuffer(GLuint framebuffer)
+{
+    if (changed(draw_framebuffer_ != framebuffer)) {
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+        draw_framebuffer_ = framebuffer;
+    }
+}
+
+void GlState::bind_texture(GLuint unit, GLenum target, GLuint texture)
+{
+    if (unit >= max_texture_units)
+        throw std::logic_error("GlState: untracked texture unit");
+    GLuint & bound = textures_[unit][texture_target_index(target)];
+    if (!changed(bound != texture))
+        return;
+    // Only switch units when a bind actually happens.
+    if (active_texture_unit_ != unit) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        active_texture_unit_ = unit;
+        ++counters_.issued;
+    }
+    glBindTexture(target, texture);
+    bound = texture;
+}
+
+void GlState::set_enabled(GLenum capability, bool enabled)
+{
+    int & state = capabilities_[capability_index(capability)];
+    if (changed(state != int(enabled))) {
+        if (enabled)
+            glEnable(capability);
+        else
+            glDisable(capability);
+        state = enabled;
+    }
+}
+
+void GlState::blend_func(GLenum source, GLenum destination)
+{
+    if (changed(blend_func_ != std::array<GLenum, 2>{source, destination})) {
+        glBlendFunc(source, destination);
+        blend_func_ = {source, destination};
+    }
+}
+
+void GlState::depth_func(GLenum function)
+{
+    if (changed(depth_func_ != function)) {
+        glDepthFunc(function);
+        depth_func_ = function;
+    }
+}
+
+void GlState::depth_mask(bool write)
+{
+    if (changed(depth_mask_ != int(write))) {
+        glDepthMask(write ? GL_TRUE : GL_FALSE);
+        depth_mask_ = write;
+    }
+}
+
+void GlState::color_mask(bool write)
+{
+    if (changed(color_mask_ != int(write))) {
+        GLboolean value = write ? GL_TRUE : GL_FALSE;
+        glColorMask(value, value, value, value);
+        color_mask_ = write;
+    }
+}
+
+void GlState::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    if (changed(viewport_ != std::array<GLint, 4>{x, y, width, height})) {
+        glViewport(x, y, width, height);
+        viewport_ = {x, y, width, height};
+    }
+}
+
+void GlState::clear_color(float red, float green, float blue, float alpha)
+{
+    if (changed(clear_color_ != std::array<float, 4>{red, green, blue, alpha})) {
+        glClearColor(red, green, blue, alpha);
+        clear_color_ = {red, green, blue, alpha};
+    }
+}
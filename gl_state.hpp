@@ -0,0 +1,61 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <array>
+
+// Shadow copy of the GL state the frame loop touches. Setters only forward calls that change
+// something; the rest are counted as elided. Code that changes state behind the tracker's
+// back (texture uploads, program relinks) must call invalidate() afterwards.
+class GlState
+{
+public:
+    struct Counters {
+        long long issued = 0;
+        long long elided = 0;
+    };
+
+    GlState() { invalidate(); }
+
+    void invalidate();
+
+    void use_program(GLuint program);
+    void bind_vertex_array(GLuint vao);
+    void bind_draw_framebuffer(GLuint framebuffer);
+    // Supports GL_TEXTURE_2D and GL_TEXTURE_CUBE_MAP on units below max_texture_units.
+    void bind_texture(GLuint unit, GLenum target, GLuint texture);
+
+    // GL_BLEND, GL_DEPTH_TEST and GL_CULL_FACE.
+    void set_enabled(GLenum capability, bool enabled);
+    void blend_func(GLenum source, GLenum destination);
+    void depth_func(GLenum function);
+    void depth_mask(bool write);
+    void color_mask(bool write);
+    void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+    void clear_color(float red, float green, float blue, float alpha);
+
+    const Counters & counters() const { return counters_; }
+    void reset_counters() { counters_ = {}; }
+
+    static constexpr int max_texture_units = 16;
+
+private:
+    // Returns whether the call has to be issued and counts it.
+    bool changed(bool different);
+
+    static constexpr GLuint unknown = ~0u;
+
+    GLuint program_;
+    GLuint vertex_array_;
+    GLuint draw_framebuffer_;
+    GLuint active_texture_unit_;
+    std::array<std::array<GLuint, 2>, max_texture_units> textures_;
+    std::array<int, 3> capabilities_; // -1 unknown, 0 disabled, 1 enabled
+    std::array<GLenum, 2> blend_func_;
+    GLenum depth_func_;
+    int depth_mask_;
+    int color_mask_;
+    std::array<GLint, 4> viewport_;
+    std::array<float, 4> clear_color_;
+    Counters counters_;
+};
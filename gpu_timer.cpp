@@ -0,0 +1,18 @@
+#include "gpu_timer.hpp"
+
+std::vector<GpuTimer::Result> GpuTimer::poll(bool wait)
+{
+    std::vector<Result> results;
+    for (auto const & result : queries_.poll(wait)) {
+        double milliseconds = result.value * 1e-6;
+        last_[result.name] = milliseconds;
+        results.push_back({result.name, result.frame, milliseconds});
+    }
+    return results;
+}
+
+double GpuTimer::last(const std::string & name) const
+{
+    auto it = last_.find(name);
+    return it == last_.end() ? -1.0 : it->second;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "query_scopes.hpp"
+
+#include <map>
+#include <string>
+#include <vector>
+
+// GPU timing of named scopes with GL_TIME_ELAPSED queries, in milliseconds. It also counts the
+// frames every other query scope is tagged with.
+class GpuTimer
+{
+public:
+    struct Result {
+        std::string name;
+        long long frame;
+        double milliseconds;
+    };
+
+    void new_frame() { ++frame_; }
+    long long frame() const { return frame_; }
+
+    void begin(const std::string & name) { queries_.begin(name, frame_); }
+    void end() { queries_.end(); }
+
+    // Returns the scopes whose results became available since the previous call.
+    // With wait set, blocks until every submitted scope is finished.
+    std::vector<Result> poll(bool wait = false);
+
+    // Most recent result of a scope or a negative value if none arrived yet.
+    double last(const std::string & name) const;
+
+private:
+    QueryScopes queries_{GL_TIME_ELAPSED};
+    std::map<std::string, double> last_;
+    long long frame_ = 0;
+};
@@ -0,0 +1,378 @@
+#include "ibl.hpp"
+#include "texture_loader.hpp"
+
+#include <glm/ext/scalar_constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+
+// Faces of level 0 of the specular cubemap; the levels below it go down to 1x1.
+const int specular_size = 128;
+// The irradiance is projected from the first environment level at most this large, the
+// cosine lobe removes all detail a larger one would add.
+const int irradiance_size = 128;
+// Changes whenever the bake gives different results for the same inputs.
+const std::uint64_t bake_version = 1;
+
+// Texel (s, t) of a face, both in [-1, 1], faces direction origin + s * s_axis + t * t_axis.
+struct FaceAxes {
+    float origin[3];
+    float s_axis[3];
+    float t_axis[3];
+};
+
+const FaceAxes face_axes[6] = {
+    {{1, 0, 0}, {0, 0, -1}, {0, -1, 0}},
+    {{-1, 0, 0}, {0, 0, 1}, {0, -1, 0}},
+    {{0, 1, 0}, {1, 0, 0}, {0, 0, 1}},
+    {{0, -1, 0}, {1, 0, 0}, {0, 0, -1}},
+    {{0, 0, 1}, {1, 0, 0}, {0, -1, 0}},
+    {{0, 0, -1}, {-1, 0, 0}, {0, -1, 0}},
+};
+
+// Radiance times basis function times solid angle, summed over the texels.
+struct ShSums {
+    double rgb[9][3] = {};
+    double weight = 0.0;
+};
+
+std::uint64_t mix(std::uint64_t hash, std::uint64_t value)
+{
+    return (hash ^ value) * 1099511628211ull;
+}
+
+std::uint64_t mix(std::uint64_t hash, const std::string & data)
+{
+    for (unsigned char c : data)
+        hash = mix(hash, c);
+    return hash;
+}
+
+void add_texel(ShSums & sums, float s, float t, const FaceAxes & axes, const unsigned char * texel)
+{
+    // Every face is at distance 1, so the direction has length sqrt(1 + s^2 + t^2) and the
+    // texel covers a solid angle proportional to its inverse cube.
+    float inv_length = 1.f / std::sqrt(1.f + s * s + t * t);
+    float x = (axes.origin[0] + s * axes.s_axis[0] + t * axes.t_axis[0]) * inv_length;
+    float y = (axes.origin[1] + s * axes.s_axis[1] + t * axes.t_axis[1]) * inv_length;
+    float z = (axes.origin[2] + s * axes.s_axis[2] + t * axes.t_axis[2]) * inv_length;
+    float weight = inv_length * inv_length * inv_length;
+
+    const float basis[9] = {0.282095f, 0.488603f * y, 0.488603f * z, 0.488603f * x, 1.092548f * x * y, 1.092548f * y * z,
+        0.315392f * (3.f * z * z - 1.f), 1.092548f * x * z, 0.546274f * (x * x - y * y)};
+    for (int k = 0; k < 9; ++k) {
+        for (int c = 0; c < 3; ++c)
+            sums.rgb[k][c] += basis[k] * weight * texel[c];
+    }
+    sums.weight += weight;
+}
+
+#ifdef __SSE2__
+
+// Same for four texels of a row, summed per lane.
+struct ShLanes {
+    __m128 rgb[9][3];
+    __m128 weight;
+};
+
+void add_texels(ShLanes & lanes, __m128 s, float t, const FaceAxes & axes, const unsigned char * texels)
+{
+    auto direction = [&](int i) {
+        return _mm_add_ps(_mm_set1_ps(axes.origin[i] + t * axes.t_axis[i]), _mm_mul_ps(s, _mm_set1_ps(axes.s_axis[i])));
+    };
+    __m128 inv_length = _mm_div_ps(_mm_set1_ps(1.f), _mm_sqrt_ps(_mm_add_ps(_mm_set1_ps(1.f + t * t), _mm_mul_ps(s, s))));
+    __m128 x = _mm_mul_ps(direction(0), inv_length);
+    __m128 y = _mm_mul_ps(direction(1), inv_length);
+    __m128 z = _mm_mul_ps(direction(2), inv_length);
+    __m128 weight = _mm_mul_ps(_mm_mul_ps(inv_length, inv_length), inv_length);
+
+    __m128 basis[9] = {
+        _mm_set1_ps(0.282095f),
+        _mm_mul_ps(_mm_set1_ps(0.488603f), y),
+        _mm_mul_ps(_mm_set1_ps(0.488603f), z),
+        _mm_mul_ps(_mm_set1_ps(0.488603f), x),
+        _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(x, y)),
+        _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(y, z)),
+        _mm_mul_ps(_mm_set1_ps(0.315392f), _mm_sub_ps(_mm_mul_ps(_mm_set1_ps(3.f), _mm_mul_ps(z, z)), _mm_set1_ps(1.f))),
+        _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(x, z)),
+        _mm_mul_ps(_mm_set1_ps(0.546274f), _mm_sub_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y))),
+    };
+
+    // RGBA8 texels are little endian words with red in the low byte.
+    __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(texels));
+    __m128i mask = _mm_set1_epi32(0xff);
+    __m128 color[3];
+    for (int c = 0; c < 3; ++c)
+        color[c] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(pixels, 8 * c), mask)), weight);
+
+    for (int k = 0; k < 9; ++k) {
+        for (int c = 0; c < 3; ++c)
+            lanes.rgb[k][c] = _mm_add_ps(lanes.rgb[k][c], _mm_mul_ps(basis[k], color[c]));
+    }
+    lanes.weight = _mm_add_ps(lanes.weight, weight);
+}
+
+double lane_sum(__m128 value)
+{
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, value);
+    return double(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+}
+
+#endif
+
+void project_face(const unsigned char * pixels, int size, const FaceAxes & axes, ShSums & sums)
+{
+    float texel_size = 2.f / size;
+#ifdef __SSE2__
+    ShLanes lanes;
+    for (int k = 0; k < 9; ++k) {
+        for (int c = 0; c < 3; ++c)
+            lanes.rgb[k][c] = _mm_setzero_ps();
+    }
+    lanes.weight = _mm_setzero_ps();
+    __m128 lane_offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+#endif
+    for (int row = 0; row < size; ++row) {
+        float t = (row + 0.5f) * texel_size - 1.f;
+        const unsigned char * texels = pixels + std::size_t(row) * size * 4;
+        int column = 0;
+#ifdef __SSE2__
+        for (; column + 4 <= size; column += 4) {
+            __m128 s = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_set1_ps(float(column)), lane_offsets), _mm_set1_ps(texel_size)), _mm_set1_ps(1.f));
+            add_texels(lanes, s, t, axes, texels + column * 4);
+        }
+#endif
+        for (; column < size; ++column)
+            add_texel(sums, (column + 0.5f) * texel_size - 1.f, t, axes, texels + column * 4);
+    }
+#ifdef __SSE2__
+    // Lanes are flushed per face, a face has few enough texels for float sums.
+    for (int k = 0; k < 9; ++k) {
+        for (int c = 0; c < 3; ++c)
+            sums.rgb[k][c] += lane_sum(lanes.rgb[k][c]);
+    }
+    sums.weight += lane_sum(lanes.weight);
+#endif
+}
+
+std::vector<unsigned char> read_face(GLenum face, int level, int size)
+{
+    std::vector<unsigned char> pixels(std::size_t(size) * size * 4);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glGetTexImage(face, level, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    return pixels;
+}
+
+bool load_cached(const std::string & texture_path, const std::string & sh_path, EnvironmentLighting & lighting)
+{
+    if (!std::filesystem::exists(texture_path) || !std::filesystem::exists(sh_path))
+        return false;
+
+    // A damaged cache only means baking again.
+    try {
+        std::ifstream in(sh_path, std::ios::binary);
+        in.read(reinterpret_cast<char *>(lighting.irradiance_sh), sizeof(lighting.irradiance_sh));
+        if (in.gcount() != sizeof(lighting.irradiance_sh))
+            return false;
+
+        MappedFile file(texture_path);
+        std::vector<ContainerTexture> textures = parse_texture_container(file);
+        if (textures.size() != 1 || textures[0].target != GL_TEXTURE_CUBE_MAP || textures[0].width != specular_size
+            || int(textures[0].levels.size()) != lighting.specular_levels || textures[0].internal_format != GL_RGBA8)
+            return false;
+        upload_container_texture(textures[0], TextureFiltering{true, 1.f, 0.f});
+        return true;
+    } catch (const std::runtime_error &) {
+        return false;
+    }
+}
+
+// Renders every level of the specular cubemap bound to unit 0 from env_texture.
+void prefilter_specular(GLuint env_texture, GLuint specular_texture, int levels, GLuint program)
+{
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP, env_texture);
+    GLint env_size = 0;
+    glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_TEXTURE_WIDTH, &env_size);
+    // The tier's LOD bias would blur the result, which is cached for all tiers.
+    GLfloat env_lod_bias = 0.f;
+    glGetTexParameterfv(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_LOD_BIAS, &env_lod_bias);
+    glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_LOD_BIAS, 0.f);
+
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "tex"), 0);
+    glUniform1f(glGetUniformLocation(program, "source_size"), float(env_size));
+    GLint face_location = glGetUniformLocation(program, "face");
+    GLint roughness_location = glGetUniformLocation(program, "roughness");
+
+    GLuint vao, framebuffer;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+
+    for (int level = 0; level < levels; ++level) {
+        int size = std::max(1, specular_size >> level);
+        glViewport(0, 0, size, size);
+        glUniform1f(roughness_location, float(level) / (levels - 1));
+        for (int face = 0; face < 6; ++face) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, specular_texture, level);
+            if (level == 0 && face == 0 && glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                throw std::runtime_error("The specular cubemap can't be rendered to");
+            glUniform1i(face_location, face);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &framebuffer);
+    glBindVertexArray(0);
+    glDeleteVertexArrays(1, &vao);
+    glUseProgram(0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glTexParameterf(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_LOD_BIAS, env_lod_bias);
+}
+
+}
+
+std::uint64_t hash_cubemap(const std::vector<const unsigned char *> & faces, std::size_t face_size)
+{
+    // FNV-1a over 64-bit words, the faces are tens of megabytes.
+    std::uint64_t hash = mix(14695981039346656037ull, face_size);
+    for (const unsigned char * face : faces) {
+        std::size_t i = 0;
+        for (; i + 8 <= face_size; i += 8) {
+            std::uint64_t word;
+            std::memcpy(&word, face + i, 8);
+            hash = mix(hash, word);
+        }
+        for (; i < face_size; ++i)
+            hash = mix(hash, face[i]);
+    }
+    return hash;
+}
+
+void project_irradiance_sh(const std::vector<const unsigned char *> & faces, int size, glm::vec4 (&irradiance_sh)[9])
+{
+    ShSums sums;
+    for (int face = 0; face < 6; ++face)
+        project_face(faces[face], size, face_axes[face], sums);
+
+    // Normalizing the weights to the whole sphere removes the error of the discrete solid
+    // angles. The cosine lobe convolution scales band l by A_l = pi, 2pi/3, pi/4, the division by
+    // pi turns irradiance into the outgoing radiance of a white diffuse surface.
+    const double band_scale[9] = {1.0, 2.0 / 3.0, 2.0 / 3.0, 2.0 / 3.0, 0.25, 0.25, 0.25, 0.25, 0.25};
+    double scale = 4.0 * glm::pi<double>() / sums.weight / 255.0;
+    for (int k = 0; k < 9; ++k) {
+        for (int c = 0; c < 3; ++c)
+            irradiance_sh[k][c] = float(sums.rgb[k][c] * scale * band_scale[k]);
+        irradiance_sh[k][3] = 0.f;
+    }
+}
+
+EnvironmentLighting bake_environment_lighting(GLuint env_texture, std::uint64_t env_hash, ProgramCache & program_cache,
+    const ShaderLibrary & library, const std::string & cache_directory)
+{
+    ShaderProgram prefilter_program{{{GL_VERTEX_SHADER, "ibl_prefilter.vert"}, {GL_FRAGMENT_SHADER, "ibl_prefilter.frag"}}};
+    std::vector<ShaderSource> prefilter_sources = prefilter_program.sources(library, ShaderVariant{});
+
+    // The result depends on the cubemap, the filter shader and the sizes.
+    std::uint64_t key = mix(mix(mix(env_hash, bake_version), specular_size), irradiance_size);
+    for (auto const & stage : prefilter_sources)
+        key = mix(key, stage.source);
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+    std::string texture_path, sh_path;
+    if (!cache_directory.empty()) {
+        texture_path = (std::filesystem::path(cache_directory) / (name + std::string(".ktx2"))).string();
+        sh_path = (std::filesystem::path(cache_directory) / (name + std::string(".sh"))).string();
+    }
+
+    EnvironmentLighting lighting;
+    lighting.specular_levels = mip_level_count(specular_size, specular_size);
+    glActiveTexture(GL_TEXTURE0);
+    glGenTextures(1, &lighting.specular_texture);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, lighting.specular_texture);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+    if (!cache_directory.empty() && load_cached(texture_path, sh_path, lighting)) {
+        lighting.from_cache = true;
+        return lighting;
+    }
+
+    // Irradiance on the CPU from a small level of the environment.
+    glBindTexture(GL_TEXTURE_CUBE_MAP, env_texture);
+    GLint env_size = 0, env_max_level = 0;
+    glGetTexLevelParameteriv(GL_TEXTURE_CUBE_MAP_POSITIVE_X, 0, GL_TEXTURE_WIDTH, &env_size);
+    glGetTexParameteriv(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, &env_max_level);
+    int sh_level = 0;
+    while (sh_level < env_max_level && (env_size >> sh_level) > irradiance_size)
+        ++sh_level;
+    int sh_size = std::max(1, env_size >> sh_level);
+    std::vector<std::vector<unsigned char>> sh_faces;
+    std::vector<const unsigned char *> sh_face_pointers;
+    for (int face = 0; face < 6; ++face) {
+        sh_faces.push_back(read_face(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, sh_level, sh_size));
+        sh_face_pointers.push_back(sh_faces.back().data());
+    }
+    project_irradiance_sh(sh_face_pointers, sh_size, lighting.irradiance_sh);
+
+    // Specular levels on the GPU.
+    glBindTexture(GL_TEXTURE_CUBE_MAP, lighting.specular_texture);
+    if (GLEW_VERSION_4_2 || GLEW_ARB_texture_storage) {
+        glTexStorage2D(GL_TEXTURE_CUBE_MAP, lighting.specular_levels, GL_RGBA8, specular_size, specular_size);
+    } else {
+        for (int level = 0; level < lighting.specular_levels; ++level) {
+            int size = std::max(1, specular_size >> level);
+            for (int face = 0; face < 6; ++face)
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+    }
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, lighting.specular_levels - 1);
+    apply_texture_filtering(GL_TEXTURE_CUBE_MAP, TextureFiltering{true, 1.f, 0.f});
+
+    GLuint program = program_cache.create_program(prefilter_sources);
+    prefilter_specular(env_texture, lighting.specular_texture, lighting.specular_levels, program);
+    glDeleteProgram(program);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, lighting.specular_texture);
+
+    if (cache_directory.empty())
+        return lighting;
+
+    // Without a cache entry the next start simply bakes again, so write errors are ignored.
+    std::vector<std::vector<unsigned char>> levels_pixels;
+    std::vector<std::vector<const unsigned char *>> levels;
+    for (int level = 0; level < lighting.specular_levels; ++level) {
+        int size = std::max(1, specular_size >> level);
+        auto & faces = levels.emplace_back();
+        for (int face = 0; face < 6; ++face) {
+            levels_pixels.push_back(read_face(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, size));
+            faces.push_back(levels_pixels.back().data());
+        }
+    }
+    std::error_code error;
+    std::filesystem::create_directories(cache_directory, error);
+    std::ofstream texture_out(texture_path, std::ios::binary);
+    write_ktx2_rgba8_mipmapped(texture_out, specular_size, specular_size, levels);
+    std::ofstream sh_out(sh_path, std::ios::binary);
+    sh_out.write(reinterpret_cast<const char *>(lighting.irradiance_sh), sizeof(lighting.irradiance_sh));
+    return lighting;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "shader.hpp"
+
+#include <GL/glew.h>
+
+#include <glm/vec4.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Image-based lighting derived once from the environment cubemap: diffuse irradiance as
+// spherical harmonics and a GGX-prefiltered cubemap for specular reflections.
+struct EnvironmentLighting {
+    // 9 coefficients per channel (rgb in xyz) of the irradiance, convolved with the cosine lobe
+    // and divided by pi; evaluated by sh_irradiance in shaders/ibl.glsl.
+    glm::vec4 irradiance_sh[9];
+    // Level i is filtered for roughness i / (specular_levels - 1).
+    GLuint specular_texture = 0;
+    int specular_levels = 0;
+    bool from_cache = false;
+};
+
+// Cache key of a cubemap from the bytes of its six base level faces.
+std::uint64_t hash_cubemap(const std::vector<const unsigned char *> & faces, std::size_t face_size);
+
+// Projects six RGBA8 size x size faces, in GL face order, onto the irradiance coefficients.
+void project_irradiance_sh(const std::vector<const unsigned char *> & faces, int size, glm::vec4 (&irradiance_sh)[9]);
+
+// Loads the lighting of env_texture, identified by env_hash, from cache_directory or bakes it
+// (the specular levels on the GPU) and stores it there. An empty directory disables the cache.
+// Uses texture unit 0 and leaves the specular cubemap bound to it.
+EnvironmentLighting bake_environment_lighting(GLuint env_texture, std::uint64_t env_hash, ProgramCache & program_cache,
+    const ShaderLibrary & library, const std::string & cache_directory);
@@ -0,0 +1,324 @@
+#include "json.hpp"
+
+#include <charconv>
+#include <stdexcept>
+
+namespace
+{
+
+// Nesting deeper than this is rejected instead of overflowing the stack.
+const int max_depth = 64;
+
+class Parser
+{
+public:
+    explicit Parser(std::string_view text)
+        : text_(text)
+    {}
+
+    JsonValue parse_document()
+    {
+        skip_whitespace();
+        JsonValue value = parse_value(0);
+        skip_whitespace();
+        if (pos_ != text_.size())
+            fail("unexpected data after the value");
+        return value;
+    }
+
+private:
+    [[noreturn]] void fail(const std::string & message) const
+    {
+        int line = 1;
+        int column = 1;
+        for (std::size_t i = 0; i < pos_ && i < text_.size(); ++i) {
+            if (text_[i] == '\n') {
+                ++line;
+                column = 1;
+            } else {
+                ++column;
+            }
+        }
+        throw std::runtime_error("line " + std::to_string(line) + ", column " + std::to_string(column) + ": " + message);
+    }
+
+    bool at_end() const { return pos_ >= text_.size(); }
+    char peek() const { return at_end() ? '\0' : text_[pos_]; }
+
+    void skip_whitespace()
+    {
+        while (!at_end() && (peek() == ' ' || peek() == '\t' || peek() == '\r' || peek() == '\n')) {
+            if (peek() == '\n')
+                ++line_;
+            ++pos_;
+        }
+    }
+
+    void expect(char c)
+    {
+        if (peek() != c)
+            fail(std::string("expected '") + c + "'");
+        ++pos_;
+    }
+
+    void expect_literal(std::string_view literal)
+    {
+        if (text_.substr(pos_, literal.size()) != literal)
+            fail("invalid literal");
+        pos_ += literal.size();
+    }
+
+    JsonValue parse_value(int depth)
+    {
+        if (depth > max_depth)
+            fail("nesting too deep");
+
+        JsonValue value;
+        value.line = line_;
+        switch (peek()) {
+        case '{':
+            value.type = JsonValue::Type::object;
+            parse_object(value, depth);
+            break;
+        case '[':
+            value.type = JsonValue::Type::array;
+            parse_array(value, depth);
+            break;
+        case '"':
+            value.type = JsonValue::Type::string;
+            value.string = parse_string();
+            break;
+        case 't':
+            expect_literal("true");
+            value.type = JsonValue::Type::boolean;
+            value.boolean = true;
+            break;
+        case 'f':
+            expect_literal("false");
+            value.type = JsonValue::Type::boolean;
+            break;
+        case 'n':
+            expect_literal("null");
+            break;
+        case '\0':
+            if (at_end())
+                fail("unexpected end of input");
+            [[fallthrough]];
+        default:
+            if (peek() == '-' || (peek() >= '0' && peek() <= '9')) {
+                value.type = JsonValue::Type::number;
+                value.number = parse_number();
+            } else {
+                fail(std::string("unexpected character '") + peek() + "'");
+            }
+        }
+        return value;
+    }
+
+    void parse_object(JsonValue & value, int depth)
+    {
+        expect('{');
+        skip_whitespace();
+        if (peek() == '}') {
+            ++pos_;
+            return;
+        }
+        while (true) {
+            skip_whitespace();
+            if (peek() != '"')
+                fail("expected a string key");
+            std::size_t key_pos = pos_;
+            std::string key = parse_string();
+            for (auto const & member : value.object) {
+                if (member.first == key) {
+                    pos_ = key_pos;
+                    fail("duplicate key \"" + key + "\"");
+                }
+            }
+            skip_whitespace();
+            expect(':');
+            skip_whitespace();
+            value.object.emplace_back(std::move(key), parse_value(depth + 1));
+            skip_whitespace();
+            if (peek() == ',') {
+                ++pos_;
+                continue;
+            }
+            expect('}');
+            return;
+        }
+    }
+
+    void parse_array(JsonValue & value, int depth)
+    {
+        expect('[');
+        skip_whitespace();
+        if (peek() == ']') {
+            ++pos_;
+            return;
+        }
+        while (true) {
+            skip_whitespace();
+            value.array.push_back(parse_value(depth + 1));
+            skip_whitespace();
+            if (peek() == ',') {
+                ++pos_;
+                continue;
+            }
+            expect(']');
+            return;
+        }
+    }
+
+    unsigned parse_hex4()
+    {
+        unsigned code = 0;
+        for (int i = 0; i < 4; ++i, ++pos_) {
+            char c = peek();
+            code <<= 4;
+            if (c >= '0' && c <= '9')
+                code |= c - '0';
+            else if (c >= 'a' && c <= 'f')
+                code |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F')
+                code |= c - 'A' + 10;
+            else
+                fail("invalid \\u escape");
+        }
+        return code;
+    }
+
+    static void append_utf8(std::string & out, unsigned code)
+    {
+        if (code < 0x80) {
+            out += char(code);
+        } else if (code < 0x800) {
+            out += char(0xc0 | (code >> 6));
+            out += char(0x80 | (code & 0x3f));
+        } else if (code < 0x10000) {
+            out += char(0xe0 | (code >> 12));
+            out += char(0x80 | ((code >> 6) & 0x3f));
+            out += char(0x80 | (code & 0x3f));
+        } else {
+            out += char(0xf0 | (code >> 18));
+            out += char(0x80 | ((code >> 12) & 0x3f));
+            out += char(0x80 | ((code >> 6) & 0x3f));
+            out += char(0x80 | (code & 0x3f));
+        }
+    }
+
+    std::string parse_string()
+    {
+        expect('"');
+        std::string result;
+        while (true) {
+            if (at_end())
+                fail("unterminated string");
+            char c = text_[pos_++];
+            if (c == '"')
+                return result;
+            if (static_cast<unsigned char>(c) < 0x20) {
+                --pos_;
+                fail("control character in string");
+            }
+            if (c != '\\') {
+                result += c;
+                continue;
+            }
+            char escape = peek();
+            ++pos_;
+            switch (escape) {
+            case '"': result += '"'; break;
+            case '\\': result += '\\'; break;
+            case '/': result += '/'; break;
+            case 'b': result += '\b'; break;
+            case 'f': result += '\f'; break;
+            case 'n': result += '\n'; break;
+            case 'r': result += '\r'; break;
+            case 't': result += '\t'; break;
+            case 'u': {
+                unsigned code = parse_hex4();
+                // Characters outside the BMP come as a surrogate pair.
+                if (code >= 0xd800 && code < 0xdc00) {
+                    if (text_.substr(pos_, 2) != "\\u")
+                        fail("unpaired surrogate");
+                    pos_ += 2;
+                    unsigned low = parse_hex4();
+                    if (low < 0xdc00 || low >= 0xe000)
+                        fail("unpaired surrogate");
+                    code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                } else if (code >= 0xdc00 && code < 0xe000) {
+                    fail("unpaired surrogate");
+                }
+                append_utf8(result, code);
+                break;
+            }
+            default:
+                --pos_;
+                fail("invalid escape");
+            }
+        }
+    }
+
+    double parse_number()
+    {
+        // Checked against the JSON grammar first: from_chars alone would accept "01" or "1.".
+        std::size_t start = pos_;
+        auto digits = [&] {
+            std::size_t first = pos_;
+            while (peek() >= '0' && peek() <= '9')
+                ++pos_;
+            return pos_ - first;
+        };
+        if (peek() == '-')
+            ++pos_;
+        if (peek() == '0')
+            ++pos_;
+        else if (digits() == 0)
+            fail("invalid number");
+        if (peek() == '.') {
+            ++pos_;
+            if (digits() == 0)
+                fail("invalid number");
+        }
+        if (peek() == 'e' || peek() == 'E') {
+            ++pos_;
+            if (peek() == '+' || peek() == '-')
+                ++pos_;
+            if (digits() == 0)
+                fail("invalid number");
+        }
+
+        double number = 0.0;
+        auto result = std::from_chars(text_.data() + start, text_.data() + pos_, number);
+        if (result.ec == std::errc::result_out_of_range) {
+            pos_ = start;
+            fail("number out of range");
+        }
+        return number;
+    }
+
+    std::string_view text_;
+    std::size_t pos_ = 0;
+    int line_ = 1;
+};
+
+}
+
+const char * JsonValue::type_name() const
+{
+    switch (type) {
+    case Type::null: return "null";
+    case Type::boolean: return "a boolean";
+    case Type::number: return "a number";
+    case Type::string: return "a string";
+    case Type::array: return "an array";
+    case Type::object: return "an object";
+    }
+    return "unknown";
+}
+
+JsonValue parse_json(std::string_view text)
+{
+    return Parser(text).parse_document();
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A parsed JSON document. Only the member matching type is set; line is where the value starts,
+// so callers can point at it in their own error messages.
+struct JsonValue {
+    enum class Type { null, boolean, number, string, array, object };
+
+    Type type = Type::null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    // Members in file order.
+    std::vector<std::pair<std::string, JsonValue>> object;
+    int line = 1;
+
+    const char * type_name() const;
+};
+
+// Parses a complete document (RFC 8259). Throws std::runtime_error with the line and column of
+// the first syntax error; duplicate object keys are rejected.
+JsonValue parse_json(std::string_view text);
@@ -8,6 +8,7 @@
 #include <GL/glew.h>
 
 #include <string_view>
+#include <algorithm>
 #include <stdexcept>
 #include <iostream>
 #include <fstream>
@@ -16,7 +17,14 @@
 #include <random>
 #include <map>
 #include <cmath>
+#include <cctype>
 #include <filesystem>
+#include <memory>
+#include <future>
+#include <optional>
+#include <thread>
+#include <atomic>
+#include <exception>
 
 #include <glm/vec3.hpp>
 #include <glm/mat4x4.hpp>
@@ -27,6 +35,25 @@
 #include <glm/gtx/string_cast.hpp>
 
 #include "stb_image.h"
+#include "texture_loader.hpp"
+#include "shader.hpp"
+#include "shader_watcher.hpp"
+#include "uniform_buffer.hpp"
+#include "gl_state.hpp"
+#include "gpu_timer.hpp"
+#include "query_scopes.hpp"
+#include "render_graph.hpp"
+#include "frame_snapshot.hpp"
+#include "triple_buffer.hpp"
+#include "dynamic_resolution.hpp"
+#include "frame_pacer.hpp"
+#include "frame_capture.hpp"
+#include "poster.hpp"
+#include "benchmark.hpp"
+#include "scene_config.hpp"
+#include "quality.hpp"
+#include "mesh.hpp"
+#include "ibl.hpp"
 
 std::string to_string(std::string_view str)
 {
@@ -43,356 +70,195 @@ void glew_fail(std::string_view message, GLenum error)
     throw std::runtime_error(to_string(message) + reinterpret_cast<const char *>(glewGetErrorString(error)));
 }
 
-const char floor_vertex_shader_source[] =
-R"(#version 330 core
-
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-
-layout (location = 0) in vec3 in_position;
-layout (location = 1) in vec3 in_normal;
-layout (location = 2) in vec2 in_texcoord;
-
-out vec3 position;
-out vec3 normal;
-out vec2 texcoord;
-
-void main()
-{
-    gl_Position = projection * view * model * vec4(in_position, 1.0);
-    position = (model * vec4(in_position, 1.0)).xyz;
-    texcoord = in_texcoord;
-    normal = in_normal;
-}
-)";
-
-const char floor_fragment_shader_source[] =
-R"(#version 330 core
-
-uniform vec3 camera_position;
-uniform vec3 ambient_light;
-
-uniform vec3 sun_light;
-uniform vec3 sun_direction;
-
-uniform float glossiness;
-uniform float roughness;
-
-uniform sampler2D tex;
-uniform sampler2D caustics_tex;
-
-in vec3 position;
-in vec3 normal;
-in vec2 texcoord;
-
-layout (location = 0) out vec4 out_color;
-
-float diffuse(vec3 direction) {
-    return max(0.0, dot(normal, direction));
-}
-
-vec3 reflect(vec3 direction) {
-    float cosine = dot(normal, direction);
-    return 2.0 * normal * cosine - direction;
-}
-
-float specular(vec3 direction) {
-    vec3 view_direction = normalize(camera_position - position);
-    vec3 reflected = reflect(direction);
-    float power = 1 / (roughness * roughness) - 1;
-    return glossiness * pow(max(0.0, dot(reflected, view_direction)), power);
-}
-
-void main()
-{
-    vec2 caustics_texcoord = vec2(position.x / 40.0, position.z / 8.0);
-    vec4 caustics_data = texture(caustics_tex, caustics_texcoord);
-    vec3 albedo = texture(tex, texcoord).xyz + caustics_data.w * caustics_data.xyz;
-    // albedo = caustics_data.xyz;
-    vec3 color = albedo * ambient_light;
-    float sun_impact = diffuse(sun_direction) + specular(sun_direction);
-    color += albedo * sun_impact * sun_light;
-    out_color = vec4(color, 1.0);
-}
-)";
-
-
-const char env_vertex_shader_source[] =
-R"(#version 330 core
-
-layout (location = 0) in vec3 in_position;
-
-uniform mat4 model;
-uniform mat4 view;
-
-out vec3 position;
-
-void main()
-{
-    gl_Position = view * model * vec4(in_position, 1.0);
-    gl_Position.z = gl_Position.w;
-    position = in_position;
-}
-)";
-
-const char env_fragment_shader_source[] =
-R"(#version 330 core
-
-uniform samplerCube tex;
-
-in vec3 position;
-
-layout (location = 0) out vec4 out_color;
-
-void main()
-{
-    vec3 color = texture(tex, position).rgb;
-    out_color = vec4(color, 1.0);
-}
-)";
-
-const char water_vertex_shader_source[] =
-R"(#version 330 core
-
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform float time;
-
-layout (location = 0) in vec2 in_position;
-
-out vec3 position;
-out vec3 normal;
-
-float get_height() {
-    float base_height = 5;
-    float add = 0.5 * sin(in_position.x + time) + 0.2 * cos(in_position.y + 3 * time) + 0.1 * sin(in_position.x + 2 * in_position.y + time);
-    return base_height + add;
-}
-
-float dhdx() {
-    return 0.5 * cos(in_position.x + time) + 0.1 * cos(in_position.x + 2 * in_position.y + time);
-}
-
-float dhdy() {
-    return -0.2 * sin(in_position.y + 3 * time) + 0.2 * cos(in_position.x + 2 * in_position.y + time);
-}
-
-void main()
-{
-    position = vec3(in_position.x, get_height(), in_position.y);
-    gl_Position = projection * view * model * vec4(position, 1.0);
-    position = (model * vec4(position, 1.0)).xyz;
-    normal = normalize(vec3(-dhdx(), 1.0, -dhdy()));
-}
-)";
-
-const char water_fragment_shader_source[] =
-R"(#version 330 core
-
-uniform vec3 camera_position;
-uniform vec3 ambient_light;
-
-uniform vec3 sun_light;
-uniform vec3 sun_direction;
-
-uniform float glossiness;
-uniform float roughness;
-
-uniform samplerCube tex;
-uniform sampler2D floor_tex;
-uniform sampler2D caustics_tex;
-
-uniform float floor_width;
-uniform float floor_height;
-
-in vec3 position;
-in vec3 normal;
-
-layout (location = 0) out vec4 out_color;
-
-float diffuse(vec3 direction) {
-    return max(0.0, dot(vec3(0.0, 1.0, 0.0), direction));
-}
-
-vec3 reflect(vec3 direction) {
-    float cosine = dot(normal, direction);
-    return 2.0 * normal * cosine - direction;
-}
-
-vec3 get_floor(vec3 pos) { 
-    vec4 caustics_data = texture(caustics_tex, vec2(pos.x / 40.0, pos.z / 8.0));
-    vec3 albedo = texture(floor_tex, vec2(pos.x / 4.0, pos.z / 4.0)).xyz;
-    albedo += caustics_data.w * caustics_data.xyz;
-    vec3 color = albedo * ambient_light;
-    float sun_impact = diffuse(sun_direction);
-    color += albedo * sun_impact * sun_light;
-    return color;
-}
-
-vec3 get_refract(vec3 direction, float n1, float n2) {
-    float cosine = dot(normalize(normal), direction);
-    float sine = sqrt(1 - cosine * cosine);
-    float refract_sine = n1 * sine / n2;
-    float refract_cosine = sqrt(1 - refract_sine * refract_sine);
-    float h = position.y;
-    float straight_floor_x = -direction.x * h / direction.y + position.x;
-    float straight_floor_z = -direction.z * h / direction.y + position.z;
-    vec3 projection_position = vec3(position.x, 0.0, position.y);
-    vec3 straight_projection = vec3(straight_floor_x, 0.0, straight_floor_z) - projection_position;
-    vec3 refracted_projection = straight_projection * n1 / n2 * cosine / refract_cosine;
-    vec3 refracted_position = projection_position + refracted_projection;
-    if (refracted_position.x > 0 && refracted_position.z > 0 && refracted_position.x < floor_width && refracted_position.z < floor_height) {
-        return get_floor(refracted_position);
-    }
-    vec3 refracted_ray = normalize(refracted_position - position);
-    return texture(tex, refracted_ray).rgb;
-}
-
-void main()
-{
-    vec3 view_direction = normalize(camera_position - position);
-    float n1 = 1.0;
-    float n2 = 1.333;
-    float cosine = dot(normalize(normal), sun_direction);
-    float coef = (n1 - n2) / (n1 + n2);
-    coef = coef * coef;
-    coef = coef + (1 - coef) * pow(1 - cosine, 5);
-    vec3 reflect_color = coef * texture(tex, reflect(view_direction)).rgb;
-    vec3 refract_color = (1 - coef) * get_refract(view_direction, n1, n2);
-    vec3 color = reflect_color + refract_color;
-    out_color = vec4(color, 1.0);
-    // out_color = vec4(vec3(1 - cosine), 1.0);
-}
-)";
-
-const char caustic_vertex_shader_source[] =
-R"(#version 330 core
-
-uniform mat4 model;
-uniform float time;
-uniform vec3 sun_direction;
-
-layout (location = 0) in vec2 in_position;
-
-float get_height() {
-    float base_height = 5;
-    float add = 0.5 * sin(in_position.x + time) + 0.2 * cos(in_position.y + 3 * time) + 0.1 * sin(in_position.x + 2 * in_position.y + time);
-    return base_height + add;
-}
-
-float dhdx() {
-    return 0.5 * cos(in_position.x + time) + 0.1 * cos(in_position.x + 2 * in_position.y + time);
-}
-
-float dhdy() {
-    return -0.2 * sin(in_position.y + 3 * time) + 0.2 * cos(in_position.x + 2 * in_position.y + time);
-}
-
-vec3 get_refract(vec3 direction, float n1, float n2, vec3 normal, vec3 position) {
-    float cosine = dot(normalize(normal), direction);
-    float sine = sqrt(1 - cosine * cosine);
-    float refract_sine = n1 * sine / n2;
-    float refract_cosine = sqrt(1 - refract_sine * refract_sine);
-    float h = position.y;
-    float straight_floor_x = -direction.x * h / direction.y + position.x;
-    float straight_floor_z = -direction.z * h / direction.y + position.z;
-    vec3 projection_position = vec3(position.x, 0.0, position.y);
-    vec3 straight_projection = vec3(straight_floor_x, 0.0, straight_floor_z) - projection_position;
-    vec3 refracted_projection = straight_projection * n1 / n2 * cosine / refract_cosine;
-    vec3 refracted_position = projection_position + refracted_projection;
-    return refracted_position;
-}
-
-void main()
-{
-    vec3 position = vec3(in_position.x, get_height(), in_position.y);
-    position = (model * vec4(position, 1.0)).xyz;
-    vec3 normal = normalize(vec3(-dhdx(), 1.0, -dhdy()));
-    vec2 texcoord = get_refract(sun_direction, 1.0, 1.33, normal, position).xz;
-    texcoord.x /= 40.0;
-    texcoord.y /= 8.0;
-    gl_Position = vec4(texcoord * 2.0 - 1.0, 0.0, 1.0);
-}
-)";
-
-const char caustic_fragment_shader_source[] =
-R"(#version 330 core
-
-uniform vec3 sun_light;
-uniform vec3 sun_direction;
-
-in vec3 normal;
-
-layout (location = 0) out vec4 out_color;
-
-void main()
+// Decodes floor.png and the environment cubemap once and stores them as a single pack of
+// uncompressed KTX2 images, so that later startups only map one file.
+void bake_texture_pack(const std::string & pack_path, const std::string & floor_texture_path,
+    const std::string & env_path, const std::string (&env_names)[6])
 {
-    float n1 = 1.0;
-    float n2 = 1.333;
-    float cosine = dot(normalize(normal), sun_direction);
-    float coef = (n1 - n2) / (n1 + n2);
-    coef = coef * coef;
-    coef = coef + (1 - coef) * pow(1 - cosine, 5);
-    vec3 color = (1 - coef) * sun_light;
-    out_color = vec4(sun_light, 1.0 - coef);
-}
-)";
+    std::ofstream out(pack_path, std::ios::binary);
+    if (!out)
+        throw std::runtime_error("Can't write " + pack_path);
 
+    auto floor_image = decode_image_rgba8(floor_texture_path);
+    write_ktx2_rgba8(out, floor_image.width, floor_image.height, {floor_image.pixels.get()});
 
-GLuint create_shader(GLenum type, const char * source)
-{
-    GLuint result = glCreateShader(type);
-    glShaderSource(result, 1, &source, nullptr);
-    glCompileShader(result);
-    GLint status;
-    glGetShaderiv(result, GL_COMPILE_STATUS, &status);
-    if (status != GL_TRUE)
-    {
-        GLint info_log_length;
-        glGetShaderiv(result, GL_INFO_LOG_LENGTH, &info_log_length);
-        std::string info_log(info_log_length, '\0');
-        glGetShaderInfoLog(result, info_log.size(), nullptr, info_log.data());
-        throw std::runtime_error("Shader compilation failed: " + info_log);
+    std::vector<DecodedImage> env_images;
+    std::vector<const unsigned char *> faces;
+    for (int i = 0; i < 6; ++i) {
+        env_images.push_back(decode_image_rgba8(env_path + env_names[i]));
+        faces.push_back(env_images.back().pixels.get());
     }
-    return result;
+    write_ktx2_rgba8(out, env_images[0].width, env_images[0].height, faces);
 }
 
-template <typename ... Shaders>
-GLuint create_program(Shaders ... shaders)
+int main(int argc, char ** argv) try
 {
-    GLuint result = glCreateProgram();
-    (glAttachShader(result, shaders), ...);
-    glLinkProgram(result);
-
-    GLint status;
-    glGetProgramiv(result, GL_LINK_STATUS, &status);
-    if (status != GL_TRUE)
-    {
-        GLint info_log_length;
-        glGetProgramiv(result, GL_INFO_LOG_LENGTH, &info_log_length);
-        std::string info_log(info_log_length, '\0');
-        glGetProgramInfoLog(result, info_log.size(), nullptr, info_log.data());
-        throw std::runtime_error("Program linkage failed: " + info_log);
+    bool bake_textures = false;
+    bool use_shader_cache = true;
+    int benchmark_frames = 0;
+    TextureFiltering texture_filtering;
+    ShaderVariant shader_variant;
+    bool sky_first = false;
+    bool water_prepass = true;
+    bool compare_water_prepass = false;
+    bool packed_vertices = true;
+    bool compare_vertex_formats = false;
+    bool fxaa = false;
+    int msaa_samples = 1;
+    bool compare_antialiasing = false;
+    bool use_dynamic_resolution = true;
+    std::optional<double> frame_budget;
+    FramePacing frame_pacing;
+    std::optional<VsyncMode> vsync;
+    std::optional<int> max_frames_ahead;
+    std::string capture_path;
+    int capture_frames = 600;
+    int capture_fps = 60;
+    int poster_width = 0;
+    int poster_height = 0;
+    int poster_tile_size = 1024;
+    std::string poster_path = "poster.png";
+    std::string scene_path;
+    std::optional<QualityTier> quality_tier;
+    bool detect_quality = false;
+    // Set explicitly, these win over the quality tier.
+    std::optional<int> wave_count;
+    bool no_caustics = false;
+    bool no_taa = false;
+    std::optional<float> anisotropy;
+    std::optional<float> reflection_scale;
+    std::optional<int> reflection_interval;
+    std::optional<int> bloom_levels;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        // The value of an option that requires one.
+        auto value = [&]() -> const char * {
+            if (i + 1 >= argc)
+                throw std::runtime_error(to_string(arg) + " expects a value");
+            return argv[++i];
+        };
+        // The numeric value of an option, parsed with parse(text, &end) which has to use up the
+        // whole text.
+        auto number = [&](auto parse) {
+            std::string text = value();
+            try {
+                std::size_t end = 0;
+                auto result = parse(text, &end);
+                if (end == text.size())
+                    return result;
+            } catch (const std::invalid_argument &) {
+            } catch (const std::out_of_range &) {
+            }
+            throw std::runtime_error(to_string(arg) + " expects a number, got " + text);
+        };
+        auto integer_value = [&] {
+            return number([](const std::string & text, std::size_t * end) { return std::stoi(text, end); });
+        };
+        auto real_value = [&] {
+            return number([](const std::string & text, std::size_t * end) { return std::stod(text, end); });
+        };
+        if (arg == "--bake-textures")
+            bake_textures = true;
+        else if (arg == "--benchmark")
+            benchmark_frames = (i + 1 < argc && std::isdigit(argv[i + 1][0])) ? std::stoi(argv[++i]) : 120;
+        else if (arg == "--no-shader-cache")
+            use_shader_cache = false;
+        else if (arg == "--no-mipmaps")
+            texture_filtering.mipmaps = false;
+        else if (arg == "--anisotropy")
+            anisotropy = float(real_value());
+        else if (arg == "--waves")
+            wave_count = std::clamp(integer_value(), 1, 3);
+        else if (arg == "--no-caustics")
+            no_caustics = true;
+        else if (arg == "--reflection-scale")
+            reflection_scale = std::clamp(float(real_value()), 0.f, 1.f);
+        else if (arg == "--reflection-interval")
+            reflection_interval = std::max(1, integer_value());
+        else if (arg == "--bloom-levels")
+            bloom_levels = std::max(0, integer_value());
+        else if (arg == "--no-taa")
+            no_taa = true;
+        else if (arg == "--sky-first")
+            sky_first = true;
+        else if (arg == "--frame-budget")
+            frame_budget = real_value();
+        else if (arg == "--no-dynamic-resolution")
+            use_dynamic_resolution = false;
+        else if (arg == "--no-water-prepass")
+            water_prepass = false;
+        else if (arg == "--compare-water-prepass")
+            compare_water_prepass = true;
+        else if (arg == "--float-vertices")
+            packed_vertices = false;
+        else if (arg == "--compare-vertex-formats")
+            compare_vertex_formats = true;
+        else if (arg == "--fxaa")
+            fxaa = true;
+        else if (arg == "--msaa")
+            msaa_samples = std::max(1, integer_value());
+        else if (arg == "--compare-antialiasing")
+            compare_antialiasing = true;
+        else if (arg == "--vsync")
+            vsync = parse_vsync_mode(value());
+        else if (arg == "--fps-cap")
+            frame_pacing.fps_cap = real_value();
+        else if (arg == "--low-latency")
+            frame_pacing.low_latency = true;
+        else if (arg == "--max-frames-ahead")
+            max_frames_ahead = std::max(0, integer_value());
+        else if (arg == "--capture")
+            capture_path = value();
+        else if (arg == "--capture-frames")
+            capture_frames = std::max(1, integer_value());
+        else if (arg == "--capture-fps")
+            capture_fps = std::max(1, integer_value());
+        else if (arg == "--poster") {
+            std::string size = value();
+            auto separator = size.find('x');
+            if (separator == std::string::npos)
+                throw std::runtime_error("--poster expects WIDTHxHEIGHT, got " + size);
+            try {
+                poster_width = std::stoi(size.substr(0, separator));
+                poster_height = std::stoi(size.substr(separator + 1));
+            } catch (const std::logic_error &) {
+                throw std::runtime_error("--poster expects WIDTHxHEIGHT, got " + size);
+            }
+            if (poster_width <= 0 || poster_height <= 0)
+                throw std::runtime_error("Invalid poster size " + size);
+        }
+        else if (arg == "--poster-output")
+            poster_path = value();
+        else if (arg == "--poster-tile")
+            poster_tile_size = integer_value();
+        else if (arg == "--scene")
+            scene_path = value();
+        else if (arg == "--quality")
+            quality_tier = parse_quality_tier(value());
+        else if (arg == "--detect-quality")
+            detect_quality = true;
+        else
+            throw std::runtime_error("Unknown argument: " + to_string(arg));
     }
 
-    return result;
-}
+    bool capture = !capture_path.empty();
+    if (capture && benchmark_frames > 0)
+        throw std::runtime_error("--capture can't be combined with --benchmark");
+    if (poster_width > 0 && (capture || benchmark_frames > 0))
+        throw std::runtime_error("--poster can't be combined with --capture or --benchmark");
 
-struct Vertex {
-    glm::vec3 position;
-    glm::vec3 normal;
-    glm::vec2 texcoord;
-};
+    // scene.json next to the sources is optional, a file named with --scene is not.
+    SceneConfig scene;
+    if (scene_path.empty() && std::filesystem::exists(PROJECT_ROOT "/scene.json"))
+        scene_path = PROJECT_ROOT "/scene.json";
+    if (!scene_path.empty())
+        scene = load_scene_config(scene_path);
 
-glm::vec2 get_water_position(int i, int j, float floor_width, float floor_height, int width_water_cnt, int height_water_cnt) {
-    // std::cout << floor_width / float(width_water_cnt) * i << ' ' << floor_height / float(height_water_cnt) * j << std::endl;
-    return {floor_width / float(width_water_cnt) * i, floor_height / float(height_water_cnt) * j};
-}
+    // Benchmarks and captures run unthrottled unless vsync is asked for; low latency mode keeps
+    // at most one frame queued.
+    frame_pacing.vsync = vsync.value_or(benchmark_frames > 0 || capture ? VsyncMode::off : VsyncMode::on);
+    frame_pacing.max_frames_ahead = max_frames_ahead.value_or(frame_pacing.low_latency ? 1 : 2);
 
-int main() try
-{
     if (SDL_Init(SDL_INIT_VIDEO) != 0)
         sdl2_fail("SDL_Init: ");
 
@@ -417,6 +283,9 @@ int main() try
     int width, height;
     SDL_GetWindowSize(window, &width, &height);
 
+    if (SDL_DisplayMode mode; SDL_GetWindowDisplayMode(window, &mode) == 0 && mode.refresh_rate > 0)
+        frame_pacing.refresh_rate = mode.refresh_rate;
+
     SDL_GLContext gl_context = SDL_GL_CreateContext(window);
     if (!gl_context)
         sdl2_fail("SDL_GL_CreateContext: ");
@@ -427,120 +296,232 @@ int main() try
     if (!GLEW_VERSION_3_3)
         throw std::runtime_error("OpenGL 3.3 is not supported");
 
-    auto caustics_vertex_shader = create_shader(GL_VERTEX_SHADER, caustic_vertex_shader_source);
-    auto caustics_fragment_shader = create_shader(GL_FRAGMENT_SHADER, caustic_fragment_shader_source);
-    auto caustics_program = create_program(caustics_vertex_shader, caustics_fragment_shader);
-
-    GLuint caustics_model_location = glGetUniformLocation(caustics_program, "model");
-    GLuint caustics_time_location = glGetUniformLocation(caustics_program, "time");
-    GLuint caustics_sun_direction_location = glGetUniformLocation(caustics_program, "sun_direction");
-    GLuint caustics_sun_color_location = glGetUniformLocation(caustics_program, "sun_light");
-
-    auto water_vertex_shader = create_shader(GL_VERTEX_SHADER, water_vertex_shader_source);
-    auto water_fragment_shader = create_shader(GL_FRAGMENT_SHADER, water_fragment_shader_source);
-    auto water_program = create_program(water_vertex_shader, water_fragment_shader);
-
-    GLuint water_model_location = glGetUniformLocation(water_program, "model");
-    GLuint water_view_location = glGetUniformLocation(water_program, "view");
-    GLuint water_projection_location = glGetUniformLocation(water_program, "projection");
-    GLuint water_camera_position_location = glGetUniformLocation(water_program, "camera_position");
-    GLuint water_sun_direction_location = glGetUniformLocation(water_program, "sun_direction");
-    GLuint water_sun_color_location = glGetUniformLocation(water_program, "sun_light");
-    GLuint water_ambient_color_location = glGetUniformLocation(water_program, "ambient_light");
-    GLuint water_glossiness_location = glGetUniformLocation(water_program, "glossiness");
-    GLuint water_roughness_location = glGetUniformLocation(water_program, "roughness");
-    GLuint water_time_location = glGetUniformLocation(water_program, "time");
-    GLuint water_env_texture_location = glGetUniformLocation(water_program, "tex");
-    GLuint water_caustics_texture_location = glGetUniformLocation(water_program, "caustics_tex");
-    GLuint water_floor_texture_location = glGetUniformLocation(water_program, "floor_tex");
-    GLuint water_floor_width_location = glGetUniformLocation(water_program, "floor_width");
-    GLuint water_floor_height_location = glGetUniformLocation(water_program, "floor_height");
-
-    auto env_vertex_shader = create_shader(GL_VERTEX_SHADER, env_vertex_shader_source);
-    auto env_fragment_shader = create_shader(GL_FRAGMENT_SHADER, env_fragment_shader_source);
-    auto env_program = create_program(env_vertex_shader, env_fragment_shader);
-
-    GLuint env_texture_location = glGetUniformLocation(env_program, "tex");
-    GLuint env_model_location = glGetUniformLocation(env_program, "model");
-    GLuint env_view_location = glGetUniformLocation(env_program, "view");
-
-    auto floor_vertex_shader = create_shader(GL_VERTEX_SHADER, floor_vertex_shader_source);
-    auto floor_fragment_shader = create_shader(GL_FRAGMENT_SHADER, floor_fragment_shader_source);
-    auto floor_program = create_program(floor_vertex_shader, floor_fragment_shader);
-
-    GLuint floor_model_location = glGetUniformLocation(floor_program, "model");
-    GLuint floor_view_location = glGetUniformLocation(floor_program, "view");
-    GLuint floor_projection_location = glGetUniformLocation(floor_program, "projection");
-    GLuint floor_camera_position_location = glGetUniformLocation(floor_program, "camera_position");
-    GLuint floor_sun_direction_location = glGetUniformLocation(floor_program, "sun_direction");
-    GLuint floor_sun_color_location = glGetUniformLocation(floor_program, "sun_light");
-    GLuint floor_ambient_color_location = glGetUniformLocation(floor_program, "ambient_light");
-    GLuint floor_glossiness_location = glGetUniformLocation(floor_program, "glossiness");
-    GLuint floor_roughness_location = glGetUniformLocation(floor_program, "roughness");
-    GLuint floor_texture_location = glGetUniformLocation(floor_program, "tex");
-    GLuint floor_caustics_texture_location = glGetUniformLocation(floor_program, "caustics_tex");
-    glUseProgram(floor_program);
+    // The scene targets are multisampled rather than the window, which only receives the
+    // resolved image. Benchmarks compare FXAA with 4x. The targets are multisample textures, whose
+    // sample limits can be lower than GL_MAX_SAMPLES for renderbuffers.
+    GLint max_color_samples = 1;
+    GLint max_depth_samples = 1;
+    glGetIntegerv(GL_MAX_COLOR_TEXTURE_SAMPLES, &max_color_samples);
+    glGetIntegerv(GL_MAX_DEPTH_TEXTURE_SAMPLES, &max_depth_samples);
+    GLint max_samples = std::min(max_color_samples, max_depth_samples);
+    msaa_samples = std::min(msaa_samples, int(max_samples));
+    int compare_msaa_samples = compare_antialiasing ? std::min(4, int(max_samples)) : 0;
+
+    std::string pref_path;
+    if (char * path = SDL_GetPrefPath("WaterPool", "WaterPool")) {
+        pref_path = path;
+        SDL_free(path);
+    }
+    std::string shader_cache_directory;
+    if (use_shader_cache && !pref_path.empty())
+        shader_cache_directory = pref_path + "shader_cache";
+
+    // An explicit --quality wins. Benchmarks, captures and posters default to the high tier so
+    // their results compare across machines; otherwise the tier detected on an earlier run is
+    // used, or detection starts at the lowest tier while the program runs.
+    std::string renderer = reinterpret_cast<const char *>(glGetString(GL_RENDERER)) + std::string(" / ")
+        + reinterpret_cast<const char *>(glGetString(GL_VERSION));
+    std::string quality_path = pref_path.empty() ? std::string() : pref_path + "quality.json";
+    std::unique_ptr<QualityDetector> quality_detector;
+    if (!quality_tier && (benchmark_frames > 0 || capture || poster_width > 0))
+        quality_tier = QualityTier::high;
+    if (!quality_tier && !detect_quality && !quality_path.empty())
+        quality_tier = load_quality_tier(quality_path, renderer);
+    if (quality_tier) {
+        std::cout << "Quality tier " << quality_tier_name(*quality_tier) << std::endl;
+    } else {
+        quality_detector = std::make_unique<QualityDetector>(frame_budget.value_or(16.0));
+        quality_tier = quality_detector->tier();
+        std::cout << "Detecting the quality tier for " << renderer << std::endl;
+    }
+
+    int width_water_cnt = 0;
+    int height_water_cnt = 0;
+    int caustics_resolution = 0;
+    GLenum caustics_format = GL_RGBA8;
+    float reflection_resolution_scale = 0.f;
+    int reflection_update_interval = 1;
+    int bloom_level_count = 0;
+    // Settings of a tier and the options that override them.
+    auto apply_quality = [&](QualityTier tier) {
+        QualitySettings settings = quality_settings(tier);
+        width_water_cnt = std::max(1, int(std::lround(scene.width_water_cnt * settings.grid_scale)));
+        height_water_cnt = std::max(1, int(std::lround(scene.height_water_cnt * settings.grid_scale)));
+        caustics_resolution = std::max(16, int(std::lround(scene.caustics_resolution * settings.caustics_scale)));
+        caustics_format = settings.caustics_format;
+        texture_filtering.lod_bias = settings.mip_bias;
+        texture_filtering.anisotropy = anisotropy.value_or(settings.anisotropy);
+        shader_variant.wave_count = wave_count.value_or(settings.wave_count);
+        shader_variant.caustics = settings.caustics && !no_caustics;
+        shader_variant.quality = settings.shader_quality;
+        reflection_resolution_scale = reflection_scale.value_or(settings.reflection_scale);
+        reflection_update_interval = reflection_interval.value_or(settings.reflection_interval);
+        shader_variant.planar_reflection = reflection_resolution_scale > 0.f;
+        // A poster is a single frame, there is no history to accumulate. Multisampled targets
+        // can't be sampled by the resolve, and comparisons of the other methods go without it.
+        shader_variant.temporal_aa = !no_taa && poster_width == 0 && msaa_samples == 1 && !compare_antialiasing;
+        // Posters are drawn in tiles, the bloom would stop at their seams.
+        bloom_level_count = bloom_levels.value_or(settings.bloom_levels);
+        shader_variant.bloom = bloom_level_count > 0 && poster_width == 0;
+    };
+    apply_quality(*quality_tier);
+
+    auto programs_start = std::chrono::high_resolution_clock::now();
+    ProgramCache program_cache(shader_cache_directory);
 
     const std::string project_root = PROJECT_ROOT;
+    ShaderLibrary shader_library(project_root + "/shaders");
+
+    // Samplers always read the same texture units, so they are set once per link.
+    ShaderProgram caustics_program{{{GL_VERTEX_SHADER, "caustics.vert"}, {GL_FRAGMENT_SHADER, "caustics.frag"}}, [](GLuint program) {
+        bind_uniform_blocks(program);
+    }};
+
+    ShaderProgram water_program{{{GL_VERTEX_SHADER, "water.vert"}, {GL_FRAGMENT_SHADER, "water.frag"}}, [](GLuint program) {
+        bind_uniform_blocks(program);
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "floor_tex"), 0);
+        glUniform1i(glGetUniformLocation(program, "tex"), 1);
+        glUniform1i(glGetUniformLocation(program, "caustics_tex"), 2);
+        glUniform1i(glGetUniformLocation(program, "specular_tex"), 3);
+        glUniform1i(glGetUniformLocation(program, "opaque_color_tex"), 4);
+        glUniform1i(glGetUniformLocation(program, "opaque_depth_tex"), 5);
+        glUniform1i(glGetUniformLocation(program, "reflection_tex"), 6);
+    }};
+
+    ShaderProgram water_depth_program{{{GL_VERTEX_SHADER, "water.vert"}, {GL_FRAGMENT_SHADER, "depth.frag"}}, [](GLuint program) {
+        bind_uniform_blocks(program);
+    }, "#define DEPTH_ONLY\n"};
+
+    ShaderProgram env_program{{{GL_VERTEX_SHADER, "env.vert"}, {GL_FRAGMENT_SHADER, "env.frag"}}, [](GLuint program) {
+        bind_uniform_blocks(program);
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "tex"), 1);
+    }};
+
+    ShaderProgram floor_program{{{GL_VERTEX_SHADER, "floor.vert"}, {GL_FRAGMENT_SHADER, "floor.frag"}}, [](GLuint program) {
+        bind_uniform_blocks(program);
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "tex"), 0);
+        glUniform1i(glGetUniformLocation(program, "caustics_tex"), 2);
+    }};
+
+    ShaderProgram taa_program{{{GL_VERTEX_SHADER, "fullscreen.vert"}, {GL_FRAGMENT_SHADER, "taa.frag"}}, [](GLuint program) {
+        bind_uniform_blocks(program);
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "color_tex"), 0);
+        glUniform1i(glGetUniformLocation(program, "motion_tex"), 1);
+        glUniform1i(glGetUniformLocation(program, "depth_tex"), 2);
+        glUniform1i(glGetUniformLocation(program, "history_tex"), 3);
+    }};
+
+    ShaderProgram fxaa_program{{{GL_VERTEX_SHADER, "fullscreen.vert"}, {GL_FRAGMENT_SHADER, "fxaa.frag"}}, [](GLuint program) {
+        bind_uniform_blocks(program);
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "color_tex"), 0);
+    }};
+
+    ShaderProgram bloom_prefilter_program{{{GL_VERTEX_SHADER, "fullscreen.vert"}, {GL_FRAGMENT_SHADER, "bloom_downsample.frag"}}, [](GLuint program) {
+        bind_uniform_blocks(program);
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "color_tex"), 0);
+    }, "#define BLOOM_PREFILTER\n"};
+
+    ShaderProgram bloom_downsample_program{{{GL_VERTEX_SHADER, "fullscreen.vert"}, {GL_FRAGMENT_SHADER, "bloom_downsample.frag"}}, [](GLuint program) {
+        bind_uniform_blocks(program);
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "color_tex"), 0);
+    }};
+
+    ShaderProgram bloom_upsample_program{{{GL_VERTEX_SHADER, "fullscreen.vert"}, {GL_FRAGMENT_SHADER, "bloom_upsample.frag"}}, [](GLuint program) {
+        bind_uniform_blocks(program);
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "level_tex"), 0);
+        glUniform1i(glGetUniformLocation(program, "bloom_tex"), 1);
+    }};
+
+    ShaderProgram tonemap_program{{{GL_VERTEX_SHADER, "fullscreen.vert"}, {GL_FRAGMENT_SHADER, "tonemap.frag"}}, [](GLuint program) {
+        bind_uniform_blocks(program);
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "color_tex"), 0);
+        glUniform1i(glGetUniformLocation(program, "bloom_tex"), 1);
+    }};
+
+    std::vector<ShaderProgram *> shader_programs = {&caustics_program, &water_program, &water_depth_program, &env_program, &floor_program,
+        &taa_program, &fxaa_program, &bloom_prefilter_program, &bloom_downsample_program, &bloom_upsample_program, &tonemap_program};
+
+    // Compilation and linking run in the driver while textures are decoded and buffers are filled.
+    std::vector<PendingProgram> pending_programs;
+    for (auto program : shader_programs)
+        pending_programs.push_back(program_cache.submit_program(program->sources(shader_library, shader_variant)));
+
     std::string floor_texture_path = project_root + "/floor.png";
+    const std::string env_path = project_root + "/environment/";
+    const std::string env_names[6] = {"posx.jpg", "negx.jpg", "posy.jpg", "negy.jpg", "posz.jpg", "negz.jpg"};
+
+    // Prebuilt textures are mapped straight from disk, the pack is rebuilt with --bake-textures.
+    const std::string texture_pack_path = project_root + "/textures.pak";
+    if (bake_textures)
+        bake_texture_pack(texture_pack_path, floor_texture_path, env_path, env_names);
+
+    std::unique_ptr<MappedFile> texture_pack;
+    const ContainerTexture * packed_floor_texture = nullptr;
+    const ContainerTexture * packed_env_texture = nullptr;
+    std::vector<ContainerTexture> packed_textures;
+    if (std::filesystem::exists(texture_pack_path)) {
+        texture_pack = std::make_unique<MappedFile>(texture_pack_path);
+        packed_textures = parse_texture_container(*texture_pack);
+        for (auto const & texture : packed_textures) {
+            if (texture.target == GL_TEXTURE_2D && !packed_floor_texture)
+                packed_floor_texture = &texture;
+            if (texture.target == GL_TEXTURE_CUBE_MAP && !packed_env_texture)
+                packed_env_texture = &texture;
+        }
+    }
 
-    GLuint floor_vao, floor_vbo;
-    glGenVertexArrays(1, &floor_vao);
-    glBindVertexArray(floor_vao);
+    // Images are decoded on worker threads while this thread fills the vertex buffers.
+    std::future<DecodedImage> floor_image;
+    std::vector<std::future<DecodedImage>> env_images;
+    if (!packed_floor_texture)
+        floor_image = std::async(std::launch::async, decode_image_rgba8, floor_texture_path);
+    if (!packed_env_texture) {
+        for (int i = 0; i < 6; ++i)
+            env_images.push_back(std::async(std::launch::async, decode_image_rgba8, env_path + env_names[i]));
+    }
 
-    const float floor_width = 40;
-    const float floor_height = 8;
+    const float floor_width = scene.floor_width;
+    const float floor_height = scene.floor_height;
+    // Mean water level, base_height in shaders/waves.glsl. The planar reflection mirrors about it.
+    const float water_height = 5.f;
     glm::vec3 floor_normal = {0, 1, 0};
     std::vector<Vertex> floor_data = {{{0, 0, 0}, floor_normal, {0, 0}}, {{0, 0, floor_height}, floor_normal, {0, floor_height / 4.0}},
                                         {{floor_width, 0, 0}, floor_normal, {floor_width / 4.0, 0}}, {{floor_width, 0, 0}, floor_normal, {floor_width / 4.0, 0}}, 
                                         {{0, 0, floor_height}, floor_normal, {0, floor_height / 4.0}}, {{floor_width, 0, floor_height}, floor_normal, {floor_width / 4.0, floor_height / 4.0}}};
 
-    glGenBuffers(1, &floor_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, floor_vbo);
-    glBufferData(GL_ARRAY_BUFFER, floor_data.size() * sizeof(Vertex), floor_data.data(), GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(0));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(12));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(24));
-
-    GLuint water_vao, water_vbo;
-    glGenVertexArrays(1, &water_vao);
-    glBindVertexArray(water_vao);
-
-    const int width_water_cnt = 500;
-    const int height_water_cnt = 100;
-    std::vector<glm::vec2> water_points;
-    for (int i = 0; i < width_water_cnt; ++i) {
-        for (int j = 0; j < height_water_cnt; ++j) {
-            water_points.push_back(get_water_position(i, j, floor_width, floor_height, width_water_cnt, height_water_cnt));
-            water_points.push_back(get_water_position(i, j + 1, floor_width, floor_height, width_water_cnt, height_water_cnt));
-            water_points.push_back(get_water_position(i + 1, j, floor_width, floor_height, width_water_cnt, height_water_cnt));
-            water_points.push_back(get_water_position(i + 1, j, floor_width, floor_height, width_water_cnt, height_water_cnt));
-            water_points.push_back(get_water_position(i, j + 1, floor_width, floor_height, width_water_cnt, height_water_cnt));
-            water_points.push_back(get_water_position(i + 1, j + 1, floor_width, floor_height, width_water_cnt, height_water_cnt));
-        }
-    }
-
-    glGenBuffers(1, &water_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, water_vbo);
-    glBufferData(GL_ARRAY_BUFFER, water_points.size() * sizeof(glm::vec2), water_points.data(), GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)(0));
+    // Meshes in both vertex formats are only built when the benchmark compares them.
+    Mesh packed_floor, float_floor, packed_water, float_water;
+    auto upload_water_grids = [&] {
+        if (packed_vertices || compare_vertex_formats)
+            upload_water_grid(packed_water, width_water_cnt, height_water_cnt, true);
+        if (!packed_vertices || compare_vertex_formats)
+            upload_water_grid(float_water, width_water_cnt, height_water_cnt, false);
+    };
+    if (packed_vertices || compare_vertex_formats)
+        upload_mesh(packed_floor, floor_data, true);
+    if (!packed_vertices || compare_vertex_formats)
+        upload_mesh(float_floor, floor_data, false);
+    upload_water_grids();
 
     GLuint tex;
     glGenTextures(1, &tex);
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, tex);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    int x, y, n;
-    unsigned char* pixels_data = stbi_load(floor_texture_path.c_str(), &x, &y, &n, 4);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, x, y, 0, GL_RGBA, GL_UNSIGNED_BYTE, (void*)pixels_data);
-    stbi_image_free(pixels_data);
+    if (packed_floor_texture) {
+        upload_container_texture(*packed_floor_texture, texture_filtering);
+    } else {
+        auto image = floor_image.get();
+        upload_rgba8_texture(GL_TEXTURE_2D, image.width, image.height, {image.pixels.get()}, texture_filtering);
+    }
 
     GLuint env_vao, env_vbo;
     glGenVertexArrays(1, &env_vao);
@@ -563,63 +544,813 @@ int main() try
     glEnableVertexAttribArray(0);
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)(0));
 
+    // Full-screen passes draw one triangle from gl_VertexID, which still needs a vertex array bound.
+    GLuint fullscreen_vao;
+    glGenVertexArrays(1, &fullscreen_vao);
+
     GLuint env_tex;
     glGenTextures(1, &env_tex);
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_CUBE_MAP, env_tex);
-    const std::string env_path = project_root + "/environment/";
-    std::string env_names[6] = {"posx.jpg", "negx.jpg", "posy.jpg", "negy.jpg", "posz.jpg", "negz.jpg"};
-    for (int i = 0; i < 6; ++i) {
-        unsigned char* env_data = stbi_load((env_path + env_names[i]).c_str(), &x, &y, &n, 4);
-        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA8, x, y, 0, GL_RGBA, GL_UNSIGNED_BYTE, (void*)env_data);
-        stbi_image_free(env_data);
+    // The hash of the source pixels identifies the baked environment lighting.
+    std::uint64_t env_hash = 0;
+    if (packed_env_texture) {
+        upload_container_texture(*packed_env_texture, texture_filtering);
+        std::vector<const unsigned char *> env_faces;
+        for (auto const & face : packed_env_texture->levels[0])
+            env_faces.push_back(face.data);
+        env_hash = hash_cubemap(env_faces, packed_env_texture->levels[0][0].size);
+    } else {
+        std::vector<DecodedImage> faces;
+        std::vector<const unsigned char *> env_faces;
+        for (auto & image : env_images) {
+            faces.push_back(image.get());
+            env_faces.push_back(faces.back().pixels.get());
+        }
+        upload_rgba8_texture(GL_TEXTURE_CUBE_MAP, faces[0].width, faces[0].height, env_faces, texture_filtering);
+        env_hash = hash_cubemap(env_faces, std::size_t(faces[0].width) * faces[0].height * 4);
     }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    // Filter across cube faces, otherwise the lower mip levels show seams.
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
     glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE); 
 
+    // All textures are uploaded, the mapping is no longer needed.
+    packed_textures.clear();
+    texture_pack.reset();
 
-    const int caustics_resolution = 512;
-    GLuint caustics_tex, caustics_fbo, caustics_rbf;
-    glGenTextures(1, &caustics_tex);
-    glActiveTexture(GL_TEXTURE2);
-    glBindTexture(GL_TEXTURE_2D, caustics_tex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, caustics_resolution, caustics_resolution, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    glGenFramebuffers(1, &caustics_fbo);
-    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, caustics_fbo);
-    glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, caustics_tex, 0);
-    if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        std::cout << "Incomplete buffer" << std::endl;
+    auto programs_wait_start = std::chrono::high_resolution_clock::now();
+    std::vector<PendingProgram *> pending_program_pointers;
+    for (auto & pending : pending_programs)
+        pending_program_pointers.push_back(&pending);
+    program_cache.finish_programs(pending_program_pointers);
+    auto programs_end = std::chrono::high_resolution_clock::now();
+    std::cout << "Shader programs and assets ready in " << std::chrono::duration<double, std::milli>(programs_end - programs_start).count()
+        << " ms (" << program_cache.hits() << " cached, " << program_cache.misses() << " compiled, "
+        << std::chrono::duration<double, std::milli>(programs_end - programs_wait_start).count() << " ms waiting for the compiler)" << std::endl;
+
+    for (std::size_t i = 0; i < shader_programs.size(); ++i) {
+        shader_programs[i]->id = pending_programs[i].program;
+        shader_programs[i]->resolve(shader_programs[i]->id);
     }
 
-    auto last_frame_start = std::chrono::high_resolution_clock::now();
+    // Diffuse and specular lighting from the sky, baked once per environment and kept with the
+    // other caches. The coefficients never change, so their block is bound once for good.
+    auto ibl_start = std::chrono::high_resolution_clock::now();
+    EnvironmentLighting environment_lighting = bake_environment_lighting(env_tex, env_hash, program_cache, shader_library,
+        pref_path.empty() ? std::string() : pref_path + "ibl");
+    std::cout << "Environment lighting " << (environment_lighting.from_cache ? "loaded" : "baked") << " in "
+        << std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - ibl_start).count() << " ms" << std::endl;
+
+    EnvironmentUniforms environment_uniforms{};
+    std::copy(std::begin(environment_lighting.irradiance_sh), std::end(environment_lighting.irradiance_sh), environment_uniforms.irradiance_sh);
+    environment_uniforms.specular_max_lod = float(environment_lighting.specular_levels - 1);
+    GLuint environment_buffer;
+    glGenBuffers(1, &environment_buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, environment_buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(environment_uniforms), &environment_uniforms, GL_STATIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, environment_uniform_binding, environment_buffer);
+
+    ShaderWatcher shader_watcher(shader_library.directory());
 
     float time = 0.f;
 
     std::map<SDL_Keycode, bool> button_down;
 
-    float view_angle = 0.f;
-    float camera_distance = 1.5f;
-
-    float camera_rotation = 0.f;
-    float camera_height = 1.f;
-
-    glm::vec3 camera_position = glm::vec3(floor_width / 2.0, 10.f, 20.f);
-    glm::vec3 camera_front = glm::vec3(0.f, 0.f, -1.f);
-    glm::vec3 base_camera_front = glm::vec3(0.f, 0.f, -1.f);
+    Camera camera{glm::vec3(floor_width / 2.0, 10.f, 20.f)};
     glm::vec3 camera_up = glm::vec3(0.f, 1.f, 0.f);
 
     bool paused = false;
 
-    bool running = true;
-    while (running)
+    // Benchmarks run at full resolution unless a frame budget is given explicitly.
+    std::unique_ptr<DynamicResolution> dynamic_resolution;
+    if (use_dynamic_resolution && !capture && (frame_budget || benchmark_frames == 0))
+        dynamic_resolution = std::make_unique<DynamicResolution>(frame_budget.value_or(16.0));
+    std::unique_ptr<Benchmark> benchmark;
+    if (benchmark_frames > 0) {
+        std::string description = std::to_string(width) + "x" + std::to_string(height)
+            + (texture_filtering.mipmaps ? ", mipmaps, anisotropy " + std::to_string(int(texture_filtering.anisotropy)) + "x" : ", no mipmaps")
+            + ", " + quality_tier_name(*quality_tier) + " quality, " + shader_variant.key() + (sky_first ? ", sky first" : "")
+            + (shader_variant.planar_reflection ? " at " + std::to_string(int(std::lround(reflection_resolution_scale * 100.f)))
+                + "% every " + std::to_string(reflection_update_interval) + " frames" : "")
+            + (compare_water_prepass ? "" : water_prepass ? ", water pre-pass" : ", no water pre-pass")
+            + (compare_vertex_formats ? "" : packed_vertices ? ", packed vertices" : ", float vertices")
+            + (compare_antialiasing ? "" : (fxaa ? ", FXAA" : "") + (msaa_samples > 1 ? ", " + std::to_string(msaa_samples) + "x MSAA" : ""));
+        benchmark = std::make_unique<Benchmark>(benchmark_frames, description, compare_water_prepass, compare_vertex_formats, compare_msaa_samples);
+    }
+
+    TripleBuffer<FrameSnapshot> snapshots;
+    snapshots.back() = make_frame_snapshot(camera, scene, time, width, height);
+    snapshots.publish();
+
+    std::atomic<bool> running = true;
+    std::atomic<bool> render_finished = false;
+    std::atomic<int> resolution_percent = 100;
+    std::atomic<QualityTier> current_quality = *quality_tier;
+    std::exception_ptr render_error;
+
+    // Draws the latest snapshot until running is cleared or the benchmark or capture is done.
+    // Runs on the render thread, which owns the GL context.
+    auto render_frames = [&] {
+        if (SDL_GL_MakeCurrent(window, gl_context) != 0)
+            sdl2_fail("SDL_GL_MakeCurrent: ");
+
+        GpuTimer gpu_timer;
+        // Samples that pass the depth test in the scene passes, per GpuTimer frame: how many
+        // fragments each shaded.
+        QueryScopes sample_counter{GL_SAMPLES_PASSED};
+        UniformRing uniform_ring;
+        GlState gl_state;
+        RenderGraph render_graph(gl_state, gpu_timer);
+        FramePacer frame_pacer(frame_pacing);
+        // Benchmarks replace the camera and advance their own time by a fixed step every frame.
+        float benchmark_time = 0.f;
+        // Captures keep the camera but also use a fixed time step, and always the full window
+        // size they started with.
+        std::unique_ptr<FrameCapture> frame_capture;
+        snapshots.update();
+        auto capture_start = std::chrono::high_resolution_clock::now();
+        if (capture)
+            frame_capture = std::make_unique<FrameCapture>(capture_path, snapshots.front().width, snapshots.front().height, capture_fps, capture_frames);
+
+        // Rebuilds what depends on the tier: programs of the new shader variant, the water grid
+        // and the texture filtering. The caustics target follows with the next frame's graph.
+        auto switch_quality = [&](QualityTier tier) {
+            std::string previous_variant = shader_variant.key();
+            int previous_width_water_cnt = width_water_cnt;
+            int previous_height_water_cnt = height_water_cnt;
+            apply_quality(tier);
+            if (shader_variant.key() != previous_variant) {
+                for (auto program : shader_programs)
+                    reload_program(program_cache, shader_library, shader_variant, *program);
+            }
+            if (width_water_cnt != previous_width_water_cnt || height_water_cnt != previous_height_water_cnt)
+                upload_water_grids();
+            glBindTexture(GL_TEXTURE_2D, tex);
+            apply_texture_filtering(GL_TEXTURE_2D, texture_filtering);
+            glBindTexture(GL_TEXTURE_CUBE_MAP, env_tex);
+            apply_texture_filtering(GL_TEXTURE_CUBE_MAP, texture_filtering);
+            gl_state.invalidate();
+            current_quality = tier;
+        };
+
+        // Meshes the passes declared next draw; the benchmark can switch the vertex format per shot.
+        const Mesh * floor_mesh = packed_vertices ? &packed_floor : &float_floor;
+        const Mesh * water_mesh = packed_vertices ? &packed_water : &float_water;
+        const Mesh env_mesh{env_vao, env_vbo, GLsizei(env_data.size()), sizeof(glm::vec3)};
+        std::size_t vertex_fetch_bytes = 0;
+        auto draw_mesh = [&](const Mesh & mesh) {
+            gl_state.bind_vertex_array(mesh.vao);
+            glDrawArrays(GL_TRIANGLES, 0, mesh.vertex_count);
+            vertex_fetch_bytes += mesh.fetch_bytes();
+        };
+
+        // The scene and every copy of it before tonemapping keeps highlights above 1. R11G11B10F
+        // floats take as much memory and bandwidth as RGBA8; nothing drawn needs alpha.
+        const GLenum hdr_format = GL_R11F_G11F_B10F;
+
+        // (Re)allocates a texture that outlives the graph when it doesn't match desc, which loses
+        // its contents.
+        auto resize_texture = [&](GLuint & texture, TextureDesc & current, const TextureDesc & desc) {
+            if (texture && desc == current)
+                return false;
+            if (!texture)
+                glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, desc.format, desc.width, desc.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            gl_state.invalidate();
+            current = desc;
+            return true;
+        };
+
+        // The planar reflection outlives the graph, frames between its updates reproject the
+        // last one with the matrix it was drawn with.
+        GLuint reflection_texture = 0;
+        TextureDesc reflection_desc;
+        glm::mat4 reflection_view_projection(1.f);
+        int reflection_age = 0;
+        auto resize_reflection = [&](int reflection_width, int reflection_height) {
+            return resize_texture(reflection_texture, reflection_desc, {std::max(1, reflection_width), std::max(1, reflection_height), hdr_format});
+        };
+
+        // Temporal anti-aliasing resolves into one of two history textures while reading the
+        // other, which holds the previous frame resolved at history_size. The camera and time of
+        // that frame give the motion of every pixel since.
+        const float taa_history_weight = 0.9f;
+        GLuint history_textures[2] = {};
+        TextureDesc history_descs[2];
+        int history_index = 0;
+        bool history_valid = false;
+        glm::vec2 history_size(1.f);
+        int taa_frame = 0;
+        glm::mat4 previous_view_projection(1.f);
+        glm::mat4 previous_env_view(1.f);
+        float previous_time = 0.f;
+
+        // Camera, time and lighting of a frame as the Frame block.
+        auto make_frame_uniforms = [&](const FrameSnapshot & frame) {
+            FrameUniforms frame_uniforms{};
+            frame_uniforms.model = glm::mat4(1.f);
+            frame_uniforms.view = frame.view;
+            frame_uniforms.projection = frame.projection;
+            frame_uniforms.env_view = frame.env_view;
+            frame_uniforms.camera_position = frame.camera_position;
+            frame_uniforms.time = frame.time;
+            frame_uniforms.sun_direction = frame.sun_direction;
+            frame_uniforms.floor_width = floor_width;
+            frame_uniforms.sun_light = frame.sun_light;
+            frame_uniforms.floor_height = floor_height;
+            frame_uniforms.ambient_light = frame.ambient_light;
+            frame_uniforms.water_scale = glm::vec2(floor_width, floor_height);
+            frame_uniforms.water_offset = glm::vec2(0.f);
+            frame_uniforms.reflection_view_projection = reflection_view_projection;
+            frame_uniforms.previous_view_projection = previous_view_projection;
+            frame_uniforms.previous_env_view = previous_env_view;
+            frame_uniforms.render_size = glm::vec2(frame.width, frame.height);
+            frame_uniforms.history_size = history_size;
+            frame_uniforms.previous_time = previous_time;
+            frame_uniforms.history_weight = history_valid ? taa_history_weight : 0.f;
+            frame_uniforms.exposure = scene.exposure;
+            frame_uniforms.bloom_threshold = scene.bloom_threshold;
+            frame_uniforms.bloom_strength = scene.bloom_strength;
+            return frame_uniforms;
+        };
+        // Frame blocks of the passes declared next: the camera's, and the mirrored camera's
+        // that the reflection pass binds while it draws.
+        FrameUniforms frame_uniforms{};
+        FrameUniforms mirrored_uniforms{};
+        // Mirrors the frame for the reflection drawn with it and binds its Frame block with the
+        // projection moved by jitter, in normalized device coordinates. The reflection is not
+        // jittered, it is reused across frames.
+        auto bind_frame_uniforms = [&](const FrameSnapshot & frame, bool update_reflection, glm::vec2 jitter) {
+            if (update_reflection) {
+                FrameSnapshot mirrored = mirror_frame(frame, water_height);
+                reflection_view_projection = mirrored.projection * mirrored.view;
+                mirrored_uniforms = make_frame_uniforms(mirrored);
+            }
+            FrameSnapshot jittered = frame;
+            jittered.projection = clip_offset(jitter) * frame.projection;
+            jittered.env_view = clip_offset(jitter) * frame.env_view;
+            frame_uniforms = make_frame_uniforms(jittered);
+            frame_uniforms.jitter = jitter;
+            uniform_ring.bind(frame_uniform_binding, frame_uniforms);
+        };
+
+        auto draw_floor = [&](const RenderGraph::PassContext & context, RenderGraph::Resource caustics, bool clear_depth) {
+            gl_state.use_program(floor_program.id);
+            gl_state.set_enabled(GL_CULL_FACE, true);
+            gl_state.set_enabled(GL_BLEND, false);
+            gl_state.set_enabled(GL_DEPTH_TEST, true);
+            gl_state.depth_func(GL_LESS);
+            gl_state.depth_mask(true);
+            if (clear_depth)
+                glClear(GL_DEPTH_BUFFER_BIT);
+
+            uniform_ring.bind(material_uniform_binding, MaterialUniforms{scene.floor_material.glossiness, scene.floor_material.roughness});
+
+            gl_state.bind_texture(0, GL_TEXTURE_2D, tex);
+            if (shader_variant.caustics)
+                gl_state.bind_texture(2, GL_TEXTURE_2D, context.texture(caustics));
+
+            draw_mesh(*floor_mesh);
+        };
+
+        auto draw_fullscreen = [&] {
+            gl_state.bind_vertex_array(fullscreen_vao);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        };
+
+        // Declares the sky, floor and water passes drawing into color and depth, and into motion
+        // for temporal anti-aliasing when it isn't -1. The caustics
+        // pass that fills `caustics` is only declared with render_caustics, so an imported
+        // caustics texture can be drawn once and then shared. The water reflects `reflection`
+        // when the shader variant has the planar reflection, which is drawn again with
+        // render_reflection.
+        auto declare_scene = [&](RenderGraph::Resource color, RenderGraph::Resource depth, RenderGraph::Resource motion, int viewport_width, int viewport_height,
+            RenderGraph::Resource caustics, bool render_caustics, RenderGraph::Resource reflection, bool render_reflection, bool prepass) {
+            auto scene_pass = [&](RenderGraph::PassBuilder & pass) {
+                pass.write(color);
+                if (motion >= 0)
+                    pass.write(motion);
+                pass.depth(depth);
+                pass.viewport(viewport_width, viewport_height);
+            };
+            auto scene_pass_reading_caustics = [&](RenderGraph::PassBuilder & pass) {
+                scene_pass(pass);
+                if (shader_variant.caustics)
+                    pass.read(caustics);
+            };
+
+            if (render_caustics) {
+                render_graph.add_pass("caustics", [&](RenderGraph::PassBuilder & pass) {
+                    pass.write(caustics);
+                }, [&](const RenderGraph::PassContext &) {
+                    gl_state.use_program(caustics_program.id);
+                    gl_state.clear_color(0.f, 0.f, 0.f, 0.f);
+                    glClear(GL_COLOR_BUFFER_BIT);
+
+                    gl_state.set_enabled(GL_BLEND, true);
+                    gl_state.blend_func(GL_SRC_ALPHA, GL_ONE);
+
+                    draw_mesh(*water_mesh);
+                });
+            }
+
+            if (render_reflection) {
+                // Everything opaque is drawn through the mirrored camera, the oblique near plane
+                // drops what is below the water. The pass swaps the Frame block for the mirrored
+                // one and puts the camera's back for the passes after it.
+                auto reflection_depth = render_graph.create_texture("reflection depth", {reflection_desc.width, reflection_desc.height, GL_DEPTH_COMPONENT24});
+                render_graph.add_pass("reflection", [&](RenderGraph::PassBuilder & pass) {
+                    pass.write(reflection);
+                    pass.depth(reflection_depth);
+                    if (shader_variant.caustics)
+                        pass.read(caustics);
+                }, [&, caustics, frame = frame_uniforms, mirrored = mirrored_uniforms](const RenderGraph::PassContext & context) {
+                    uniform_ring.bind(frame_uniform_binding, mirrored);
+                    // The mirror turns the winding of every triangle around.
+                    glFrontFace(GL_CW);
+                    draw_floor(context, caustics, true);
+
+                    gl_state.use_program(env_program.id);
+                    gl_state.depth_func(GL_LEQUAL);
+                    gl_state.depth_mask(false);
+                    gl_state.bind_texture(1, GL_TEXTURE_CUBE_MAP, env_tex);
+                    draw_mesh(env_mesh);
+
+                    glFrontFace(GL_CCW);
+                    uniform_ring.bind(frame_uniform_binding, frame);
+                });
+            }
+
+            auto add_environment_pass = [&] {
+                render_graph.add_pass("env", scene_pass, [&](const RenderGraph::PassContext &) {
+                    sample_counter.begin("env", gpu_timer.frame());
+                    gl_state.use_program(env_program.id);
+                    gl_state.set_enabled(GL_CULL_FACE, true);
+                    gl_state.set_enabled(GL_BLEND, false);
+                    if (sky_first) {
+                        gl_state.set_enabled(GL_DEPTH_TEST, false);
+                        gl_state.depth_mask(true);
+                        gl_state.clear_color(0.8, 0.8, 1.f, 0.f);
+                        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                    } else {
+                        // env.vert puts the sky on the far plane, so it only passes where the
+                        // cleared depth is still untouched.
+                        gl_state.set_enabled(GL_DEPTH_TEST, true);
+                        gl_state.depth_func(GL_LEQUAL);
+                        gl_state.depth_mask(false);
+                    }
+                    gl_state.bind_texture(1, GL_TEXTURE_CUBE_MAP, env_tex);
+                    draw_mesh(env_mesh);
+                    sample_counter.end();
+                });
+            };
+
+            if (sky_first)
+                add_environment_pass();
+
+            render_graph.add_pass("floor", scene_pass_reading_caustics, [&, caustics, prepass](const RenderGraph::PassContext & context) {
+                sample_counter.begin("floor", gpu_timer.frame());
+                // Every pixel is covered by the floor, the water or the sky.
+                draw_floor(context, caustics, !sky_first);
+                sample_counter.end();
+            });
+
+            // The water refracts a copy of what is drawn before it, so underwater pixels are
+            // shaded once by their own pass instead of again by every water pixel.
+            auto opaque_color = render_graph.create_texture("opaque color", {viewport_width, viewport_height, hdr_format});
+            auto opaque_depth = render_graph.create_texture("opaque depth", {viewport_width, viewport_height, GL_DEPTH_COMPONENT24});
+            render_graph.add_pass("opaque copy", [&](RenderGraph::PassBuilder & pass) {
+                pass.read(color);
+                pass.read(depth);
+                pass.write(opaque_color);
+                pass.depth(opaque_depth);
+            }, [&, color, depth, viewport_width, viewport_height](const RenderGraph::PassContext & context) {
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, context.framebuffer(color));
+                glBlitFramebuffer(0, 0, viewport_width, viewport_height, 0, 0, viewport_width, viewport_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, context.framebuffer(depth));
+                glBlitFramebuffer(0, 0, viewport_width, viewport_height, 0, 0, viewport_width, viewport_height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+            });
+
+            // Water
+            if (prepass) {
+                // Lay down the water depth first, so the color pass below shades every visible
+                // pixel exactly once instead of every wave layer.
+                render_graph.add_pass("water z", scene_pass, [&](const RenderGraph::PassContext &) {
+                    gl_state.use_program(water_depth_program.id);
+                    gl_state.depth_func(GL_LESS);
+                    gl_state.depth_mask(true);
+                    gl_state.color_mask(false);
+                    draw_mesh(*water_mesh);
+                    gl_state.color_mask(true);
+                });
+            }
+
+            render_graph.add_pass("water", [&](RenderGraph::PassBuilder & pass) {
+                scene_pass_reading_caustics(pass);
+                pass.read(opaque_color);
+                pass.read(opaque_depth);
+                if (shader_variant.planar_reflection)
+                    pass.read(reflection);
+            }, [&, caustics, opaque_color, opaque_depth, reflection, prepass](const RenderGraph::PassContext & context) {
+                sample_counter.begin("water", gpu_timer.frame());
+                gl_state.use_program(water_program.id);
+                gl_state.set_enabled(GL_DEPTH_TEST, true);
+                gl_state.depth_func(prepass ? GL_EQUAL : GL_LESS);
+                gl_state.depth_mask(!prepass);
+
+                uniform_ring.bind(material_uniform_binding, MaterialUniforms{scene.water_material.glossiness, scene.water_material.roughness});
+
+                gl_state.bind_texture(0, GL_TEXTURE_2D, tex);
+                gl_state.bind_texture(1, GL_TEXTURE_CUBE_MAP, env_tex);
+                if (shader_variant.caustics)
+                    gl_state.bind_texture(2, GL_TEXTURE_2D, context.texture(caustics));
+                gl_state.bind_texture(3, GL_TEXTURE_CUBE_MAP, environment_lighting.specular_texture);
+                gl_state.bind_texture(4, GL_TEXTURE_2D, context.texture(opaque_color));
+                gl_state.bind_texture(5, GL_TEXTURE_2D, context.texture(opaque_depth));
+                if (shader_variant.planar_reflection)
+                    gl_state.bind_texture(6, GL_TEXTURE_2D, context.texture(reflection));
+
+                draw_mesh(*water_mesh);
+                sample_counter.end();
+            });
+
+            if (!sky_first)
+                add_environment_pass();
+        };
+
+        // Declares the passes that map the HDR image in the viewport_width x viewport_height
+        // corner of color to the display in the same corner of output. The bloom chain halves
+        // the image bloom_level_count times and adds the levels back up from the smallest.
+        auto declare_tonemap = [&](RenderGraph::Resource color, RenderGraph::Resource output, int viewport_width, int viewport_height) {
+            RenderGraph::Resource bloom = -1;
+            if (shader_variant.bloom) {
+                std::vector<RenderGraph::Resource> levels;
+                std::vector<TextureDesc> level_descs;
+                int level_width = viewport_width;
+                int level_height = viewport_height;
+                for (int i = 0; i < bloom_level_count; ++i) {
+                    level_width = std::max(1, (level_width + 1) / 2);
+                    level_height = std::max(1, (level_height + 1) / 2);
+                    auto source = i == 0 ? color : levels.back();
+                    level_descs.push_back({level_width, level_height, hdr_format});
+                    auto level = render_graph.create_texture("bloom " + std::to_string(i), level_descs.back());
+                    render_graph.add_pass("bloom", [&](RenderGraph::PassBuilder & pass) {
+                        pass.read(source);
+                        pass.write(level);
+                    }, [&, source, first = i == 0](const RenderGraph::PassContext & context) {
+                        gl_state.use_program(first ? bloom_prefilter_program.id : bloom_downsample_program.id);
+                        gl_state.set_enabled(GL_BLEND, false);
+                        gl_state.bind_texture(0, GL_TEXTURE_2D, context.texture(source));
+                        draw_fullscreen();
+                    });
+                    levels.push_back(level);
+                }
+                bloom = levels.back();
+                for (int i = int(levels.size()) - 2; i >= 0; --i) {
+                    auto level = levels[i];
+                    auto combined = render_graph.create_texture("bloom up " + std::to_string(i), level_descs[i]);
+                    render_graph.add_pass("bloom", [&](RenderGraph::PassBuilder & pass) {
+                        pass.read(level);
+                        pass.read(bloom);
+                        pass.write(combined);
+                    }, [&, level, bloom](const RenderGraph::PassContext & context) {
+                        gl_state.use_program(bloom_upsample_program.id);
+                        gl_state.set_enabled(GL_BLEND, false);
+                        gl_state.bind_texture(0, GL_TEXTURE_2D, context.texture(level));
+                        gl_state.bind_texture(1, GL_TEXTURE_2D, context.texture(bloom));
+                        draw_fullscreen();
+                    });
+                    bloom = combined;
+                }
+            }
+
+            render_graph.add_pass("tonemap", [&](RenderGraph::PassBuilder & pass) {
+                pass.read(color);
+                if (bloom >= 0)
+                    pass.read(bloom);
+                pass.write(output);
+                pass.viewport(viewport_width, viewport_height);
+            }, [&, color, bloom](const RenderGraph::PassContext & context) {
+                gl_state.use_program(tonemap_program.id);
+                gl_state.set_enabled(GL_BLEND, false);
+                gl_state.bind_texture(0, GL_TEXTURE_2D, context.texture(color));
+                if (bloom >= 0)
+                    gl_state.bind_texture(1, GL_TEXTURE_2D, context.texture(bloom));
+                draw_fullscreen();
+            });
+        };
+
+        if (poster_width > 0) {
+            auto poster_start = std::chrono::high_resolution_clock::now();
+            Poster poster(poster_path, poster_width, poster_height, poster_tile_size);
+
+            // The caustics don't depend on the camera: they are drawn with the first tile into a
+            // texture that outlives the graph and read by all the others.
+            GLuint caustics_texture;
+            glGenTextures(1, &caustics_texture);
+            glBindTexture(GL_TEXTURE_2D, caustics_texture);
+            glTexImage2D(GL_TEXTURE_2D, 0, caustics_format, caustics_resolution, caustics_resolution, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            gl_state.invalidate();
+
+            FrameSnapshot frame = snapshots.front();
+            glm::mat4 projection = camera_projection(poster.width(), poster.height());
+            auto const & tiles = poster.tiles();
+            for (std::size_t i = 0; i < tiles.size(); ++i) {
+                auto const & tile = tiles[i];
+                glm::mat4 transform = tile_transform(poster.width(), poster.height(), tile.x, tile.y, tile.x + tile.width, tile.y + tile.height);
+                FrameSnapshot tile_frame = frame;
+                tile_frame.projection = transform * projection;
+                tile_frame.env_view = transform * frame.env_view;
+
+                // Every tile has its own reflection.
+                if (shader_variant.planar_reflection)
+                    resize_reflection(int(std::ceil(tile.width * reflection_resolution_scale)), int(std::ceil(tile.height * reflection_resolution_scale)));
+
+                uniform_ring.begin_frame();
+                bind_frame_uniforms(tile_frame, shader_variant.planar_reflection, glm::vec2(0.f));
+                auto output = render_graph.import_texture("poster tile", poster.tile_texture(), {poster.tile_size(), poster.tile_size(), GL_RGBA8});
+                auto color = render_graph.create_texture("poster color", {poster.tile_size(), poster.tile_size(), hdr_format});
+                auto depth = render_graph.create_texture("poster depth", {poster.tile_size(), poster.tile_size(), GL_DEPTH_COMPONENT24});
+                auto caustics = render_graph.import_texture("caustics", caustics_texture, {caustics_resolution, caustics_resolution, caustics_format});
+                auto reflection = shader_variant.planar_reflection ? render_graph.import_texture("reflection", reflection_texture, reflection_desc) : -1;
+                declare_scene(color, depth, -1, tile.width, tile.height, caustics, i == 0 && shader_variant.caustics,
+                    reflection, shader_variant.planar_reflection, water_prepass);
+                declare_tonemap(color, output, tile.width, tile.height);
+                render_graph.execute();
+                uniform_ring.end_frame();
+
+                // The readback overlaps with rendering the next tiles.
+                poster.read_tile(i);
+                gpu_timer.new_frame();
+                gpu_timer.poll();
+                sample_counter.poll();
+            }
+            poster.finish();
+            glDeleteTextures(1, &caustics_texture);
+
+            double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - poster_start).count();
+            std::cout << "Wrote a " << poster.width() << "x" << poster.height() << " poster in " << tiles.size() << " tiles of "
+                << poster.tile_size() << " pixels to " << poster_path << " in " << seconds << " s" << std::endl;
+            return;
+        }
+
+        while (running)
+        {
+            bool relinked = false;
+            for (auto const & file : shader_watcher.poll()) {
+                for (auto program : shader_programs) {
+                    if (program->uses(file) && reload_program(program_cache, shader_library, shader_variant, *program)) {
+                        std::cout << "Reloaded " << program->stages.back().second << " after " << file << " changed" << std::endl;
+                        relinked = true;
+                    }
+                }
+            }
+            // Relinking binds the new program to set its samplers.
+            if (relinked)
+                gl_state.invalidate();
+
+            if (benchmark && benchmark->finished()) {
+                benchmark->add_gpu_results(gpu_timer.poll(true));
+                benchmark->add_sample_results(sample_counter.poll(true));
+                benchmark->report(std::cout);
+                return;
+            }
+            if (frame_capture && frame_capture->finished()) {
+                double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - capture_start).count();
+                std::cout << "Captured " << frame_capture->captured() << " frames of " << frame_capture->width() << "x" << frame_capture->height()
+                    << " to " << capture_path << " in " << seconds << " s (" << frame_capture->captured() / seconds << " fps)" << std::endl;
+                return;
+            }
+
+            frame_pacer.wait_for_frame_start();
+            auto frame_start = std::chrono::high_resolution_clock::now();
+            snapshots.update();
+            FrameSnapshot frame = snapshots.front();
+            if (benchmark) {
+                benchmark_time += benchmark->time_step();
+                auto const & shot = benchmark->shot();
+                frame = make_frame_snapshot({shot.camera_position, shot.view_angle, shot.camera_rotation}, scene, benchmark_time, frame.width, frame.height);
+            }
+            if (frame_capture)
+                frame.time = frame_capture->time();
+            int width = frame.width;
+            int height = frame.height;
+
+            // The scene is drawn into textures, whose depth the opaque copy can blit regardless of
+            // the window's depth format. With dynamic resolution it only fills a corner of them
+            // and is upscaled to the window.
+            int render_width = dynamic_resolution ? dynamic_resolution->scaled(width) : width;
+            int render_height = dynamic_resolution ? dynamic_resolution->scaled(height) : height;
+            bool upscale = render_width != width || render_height != height;
+
+            // The reflection is drawn every reflection_update_interval frames, and whenever its
+            // size changes.
+            bool update_reflection = false;
+            if (shader_variant.planar_reflection) {
+                bool resized = resize_reflection(int(std::ceil(render_width * reflection_resolution_scale)),
+                    int(std::ceil(render_height * reflection_resolution_scale)));
+                update_reflection = resized || ++reflection_age >= reflection_update_interval;
+                if (update_reflection)
+                    reflection_age = 0;
+            }
+
+            // A history at another window size is dropped, one at another render size is scaled.
+            glm::vec2 jitter(0.f);
+            if (shader_variant.temporal_aa) {
+                TextureDesc history_desc{width, height, hdr_format};
+                bool resized = resize_texture(history_textures[0], history_descs[0], history_desc);
+                resized = resize_texture(history_textures[1], history_descs[1], history_desc) || resized;
+                if (resized)
+                    history_valid = false;
+                jitter = halton_jitter(taa_frame++) * 2.f / glm::vec2(render_width, render_height);
+            } else {
+                history_valid = false;
+            }
+
+            gl_state.reset_counters();
+            uniform_ring.begin_frame();
+            FrameSnapshot render_frame = frame;
+            render_frame.width = render_width;
+            render_frame.height = render_height;
+            bind_frame_uniforms(render_frame, update_reflection, jitter);
+
+            bool use_fxaa = fxaa;
+            int samples = msaa_samples;
+            if (benchmark && benchmark->shot().fxaa)
+                use_fxaa = *benchmark->shot().fxaa;
+            if (benchmark && benchmark->shot().msaa_samples)
+                samples = *benchmark->shot().msaa_samples;
+
+            auto output = render_graph.backbuffer(width, height);
+            auto scene_color = render_graph.create_texture("scene color", {width, height, hdr_format, samples});
+            auto scene_depth = render_graph.create_texture("scene depth", {width, height, GL_DEPTH_COMPONENT24, samples});
+            // Culled when the shader variant doesn't sample caustics.
+            auto caustics = render_graph.create_texture("caustics", {caustics_resolution, caustics_resolution, caustics_format});
+
+            bool prepass = water_prepass;
+            if (benchmark && benchmark->shot().water_prepass)
+                prepass = *benchmark->shot().water_prepass;
+            bool packed = packed_vertices;
+            if (benchmark && benchmark->shot().packed_vertices)
+                packed = *benchmark->shot().packed_vertices;
+            floor_mesh = packed ? &packed_floor : &float_floor;
+            water_mesh = packed ? &packed_water : &float_water;
+            vertex_fetch_bytes = 0;
+            auto reflection = shader_variant.planar_reflection ? render_graph.import_texture("reflection", reflection_texture, reflection_desc) : -1;
+            auto motion = shader_variant.temporal_aa ? render_graph.create_texture("motion", {width, height, GL_RG16F}) : -1;
+            declare_scene(scene_color, scene_depth, motion, render_width, render_height, caustics, true, reflection, update_reflection, prepass);
+
+            auto presented = scene_color;
+            if (samples > 1) {
+                // Multisampled textures can't be sampled, a blit resolves them.
+                auto resolved = render_graph.create_texture("msaa resolved", {width, height, hdr_format});
+                render_graph.add_pass("resolve", [&](RenderGraph::PassBuilder & pass) {
+                    pass.read(scene_color);
+                    pass.write(resolved);
+                }, [&, scene_color](const RenderGraph::PassContext & context) {
+                    glBindFramebuffer(GL_READ_FRAMEBUFFER, context.framebuffer(scene_color));
+                    glBlitFramebuffer(0, 0, render_width, render_height, 0, 0, render_width, render_height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+                });
+                presented = resolved;
+            }
+            if (shader_variant.temporal_aa) {
+                // Blends the jittered frame into the reprojected history, which the next frame reads.
+                auto history = render_graph.import_texture("history", history_textures[history_index ^ 1], history_descs[0]);
+                auto resolved = render_graph.import_texture("resolved", history_textures[history_index], history_descs[0]);
+                render_graph.add_pass("taa", [&](RenderGraph::PassBuilder & pass) {
+                    pass.read(scene_color);
+                    pass.read(motion);
+                    pass.read(scene_depth);
+                    pass.read(history);
+                    pass.write(resolved);
+                    pass.viewport(render_width, render_height);
+                }, [&, scene_color, motion, scene_depth, history](const RenderGraph::PassContext & context) {
+                    gl_state.use_program(taa_program.id);
+                    gl_state.set_enabled(GL_BLEND, false);
+                    gl_state.bind_texture(0, GL_TEXTURE_2D, context.texture(scene_color));
+                    gl_state.bind_texture(1, GL_TEXTURE_2D, context.texture(motion));
+                    gl_state.bind_texture(2, GL_TEXTURE_2D, context.texture(scene_depth));
+                    gl_state.bind_texture(3, GL_TEXTURE_2D, context.texture(history));
+                    draw_fullscreen();
+                });
+                presented = resolved;
+            }
+
+            // Bloom and tonemapping read the anti-aliased HDR image, FXAA finds edges in the
+            // display values they produce.
+            auto tonemapped = render_graph.create_texture("tonemapped", {width, height, GL_RGBA8});
+            declare_tonemap(presented, tonemapped, render_width, render_height);
+            presented = tonemapped;
+            if (use_fxaa) {
+                auto antialiased = render_graph.create_texture("fxaa", {width, height, GL_RGBA8});
+                render_graph.add_pass("fxaa", [&](RenderGraph::PassBuilder & pass) {
+                    pass.read(presented);
+                    pass.write(antialiased);
+                    pass.viewport(render_width, render_height);
+                }, [&, presented](const RenderGraph::PassContext & context) {
+                    gl_state.use_program(fxaa_program.id);
+                    gl_state.set_enabled(GL_BLEND, false);
+                    gl_state.bind_texture(0, GL_TEXTURE_2D, context.texture(presented));
+                    draw_fullscreen();
+                });
+                presented = antialiased;
+            }
+
+            render_graph.add_pass("present", [&](RenderGraph::PassBuilder & pass) {
+                pass.read(presented);
+                pass.write(output);
+            }, [&, presented](const RenderGraph::PassContext & context) {
+                glBindFramebuffer(GL_READ_FRAMEBUFFER, context.framebuffer(presented));
+                glBlitFramebuffer(0, 0, render_width, render_height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, upscale ? GL_LINEAR : GL_NEAREST);
+            });
+
+            render_graph.execute();
+
+            // This frame's camera without the jitter is what the next one reprojects from.
+            previous_view_projection = frame.projection * frame.view;
+            previous_env_view = frame.env_view;
+            previous_time = frame.time;
+            if (shader_variant.temporal_aa) {
+                history_size = glm::vec2(render_width, render_height);
+                history_valid = true;
+                history_index ^= 1;
+            }
+
+            uniform_ring.end_frame();
+            auto submit_end = std::chrono::high_resolution_clock::now();
+            if (frame_capture)
+                frame_capture->capture_frame();
+            frame_pacer.frame_submitted();
+            SDL_GL_SwapWindow(window);
+            frame_pacer.frame_presented();
+
+            if (benchmark) {
+                auto frame_end = std::chrono::high_resolution_clock::now();
+                benchmark->add_frame(gpu_timer.frame(), std::chrono::duration<double, std::milli>(frame_end - frame_start).count(), gl_state.counters(), vertex_fetch_bytes,
+                    render_width * render_height);
+            }
+            // Vsync and pacing waits don't count against a tier.
+            if (quality_detector)
+                quality_detector->add_frame(gpu_timer.frame(), std::chrono::duration<double, std::milli>(submit_end - frame_start).count());
+            gpu_timer.new_frame();
+            auto gpu_results = gpu_timer.poll();
+            auto sample_results = sample_counter.poll();
+            frame_pacer.add_gpu_results(gpu_results);
+            if (quality_detector) {
+                // Tiers are measured at full resolution.
+                quality_detector->add_gpu_results(gpu_results);
+                if (quality_detector->tier() != current_quality)
+                    switch_quality(quality_detector->tier());
+                if (quality_detector->finished()) {
+                    std::cout << "Quality tier detection:";
+                    for (auto const & [tier, milliseconds] : quality_detector->measurements())
+                        std::cout << " " << quality_tier_name(tier) << " " << milliseconds << " ms";
+                    std::cout << ", using " << quality_tier_name(quality_detector->tier()) << std::endl;
+                    if (!quality_path.empty())
+                        save_quality_tier(quality_path, renderer, quality_detector->tier());
+                    quality_detector.reset();
+                }
+            } else if (dynamic_resolution) {
+                dynamic_resolution->add_gpu_results(gpu_results);
+                resolution_percent = int(std::lround(dynamic_resolution->scale() * 100.f));
+            }
+            if (benchmark) {
+                benchmark->add_gpu_results(gpu_results);
+                benchmark->add_sample_results(sample_results);
+            }
+        }
+    };
+
+    // From here on the render thread owns the context. This thread only handles input and
+    // publishes snapshots, so neither waits for SDL_GL_SwapWindow.
+    if (SDL_GL_MakeCurrent(window, nullptr) != 0)
+        sdl2_fail("SDL_GL_MakeCurrent: ");
+    std::thread render_thread([&] {
+        try {
+            render_frames();
+        } catch (...) {
+            render_error = std::current_exception();
+        }
+        render_finished = true;
+    });
+
+    auto last_frame_start = std::chrono::high_resolution_clock::now();
+    int shown_resolution_percent = -1;
+    std::optional<QualityTier> shown_quality;
+
+    while (running && !render_finished)
     {
         for (SDL_Event event; SDL_PollEvent(&event);) switch (event.type)
         {
@@ -631,7 +1362,6 @@ int main() try
             case SDL_WINDOWEVENT_RESIZED:
                 width = event.window.data1;
                 height = event.window.data2;
-                glViewport(0, 0, width, height);
                 break;
             }
             break;
@@ -655,157 +1385,52 @@ int main() try
         if (!paused) {
             time += dt;
         }
+        glm::vec3 front = camera_front(camera);
         if (button_down[SDLK_w])
-            camera_position += 6 * dt * camera_front;
+            camera.position += 6 * dt * front;
         if (button_down[SDLK_s])
-            camera_position -= 6 * dt * camera_front;
+            camera.position -= 6 * dt * front;
         if (button_down[SDLK_a])
-            camera_position -= 6 * dt * glm::normalize(glm::cross(camera_front, camera_up));
+            camera.position -= 6 * dt * glm::normalize(glm::cross(front, camera_up));
         if (button_down[SDLK_d])
-            camera_position += 6 * dt * glm::normalize(glm::cross(camera_front, camera_up));
+            camera.position += 6 * dt * glm::normalize(glm::cross(front, camera_up));
         if (button_down[SDLK_LCTRL])
-            camera_position -= 6 * dt * camera_up;
+            camera.position -= 6 * dt * camera_up;
         if (button_down[SDLK_SPACE])
-            camera_position += 6 * dt * camera_up;
+            camera.position += 6 * dt * camera_up;
 
         if (button_down[SDLK_LEFT])
-            camera_rotation -= 2.f * dt;
+            camera.rotation -= 2.f * dt;
         if (button_down[SDLK_RIGHT])
-            camera_rotation += 2.f * dt;
+            camera.rotation += 2.f * dt;
 
         if (button_down[SDLK_UP])
-            view_angle -= 2.f * dt;
+            camera.view_angle -= 2.f * dt;
         if (button_down[SDLK_DOWN])
-            view_angle += 2.f * dt;
-
-
-        float near = 0.01f;
-        float far = 100.0;
-        float aspect_ratio = width / float(height);
-
-        glm::mat4 model = glm::mat4(1.f);
-
-        glm::mat4 rotation_matrix(1.f);
-        rotation_matrix = glm::rotate(rotation_matrix, view_angle, {1.f, 0.f, 0.f});
-        rotation_matrix = glm::rotate(rotation_matrix, camera_rotation, {0.f, 1.f, 0.f});
-        camera_front = base_camera_front * glm::mat3(rotation_matrix);
-
-        glm::mat4 view(1.f);
-        view = glm::lookAt(camera_position, camera_position + camera_front, camera_up);
-
-        glm::mat4 projection = glm::perspective(glm::pi<float>() / 2.f, (1.f * width) / height, near, far);
-
-        glm::vec3 light_direction = glm::normalize(glm::vec3(0.9, 1.f, -0.2));
-        glm::vec3 sun_color = glm::vec3(1.0, 0.9, 0.8);
-
-        // Caustics
-
-        glUseProgram(caustics_program);
-
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, caustics_fbo);
-        glClearColor(0.f, 0.f, 0.f, 0.f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glViewport(0, 0, caustics_resolution, caustics_resolution);
-
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-
-        glUniformMatrix4fv(caustics_model_location, 1, GL_FALSE, reinterpret_cast<float *>(&model));
-        glUniform1f(caustics_time_location, time);
-        glUniform3fv(caustics_sun_direction_location, 1, reinterpret_cast<float *>(&light_direction));
-        glUniform3f(caustics_sun_color_location, sun_color.x, sun_color.y, sun_color.z);
-
-        glBindVertexArray(water_vao);
-        glBindBuffer(GL_ARRAY_BUFFER, water_vbo);
-
-        glDrawArrays(GL_TRIANGLES, 0, water_points.size());
-
-        // Environment
-        glUseProgram(env_program);
-        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-        glClearColor(0.8, 0.8, 1.f, 0.f);
-        glViewport(0, 0, width, height);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glEnable(GL_CULL_FACE);
-        glDisable(GL_DEPTH_TEST);
-        glDisable(GL_BLEND);
-        glUniform1i(env_texture_location, 1);
-        glUniformMatrix4fv(env_model_location, 1, GL_FALSE, reinterpret_cast<float *>(&model));
-        
-        glm::mat4 env_rotation_matrix(1.f);
-        env_rotation_matrix = glm::rotate(env_rotation_matrix, -view_angle, {1.f, 0.f, 0.f});
-        env_rotation_matrix = glm::rotate(env_rotation_matrix, -camera_rotation, {0.f, 1.f, 0.f});
-        glm::vec3 env_camera_front = base_camera_front * glm::mat3(env_rotation_matrix);
-        glm::mat4 env_view(1.f);
-        env_view = glm::lookAt(glm::vec3(0), env_camera_front, camera_up);
-        
-        glUniformMatrix4fv(env_view_location, 1, GL_FALSE, reinterpret_cast<float *>(&env_view));
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, env_tex);
-        glBindVertexArray(env_vao);
-        glBindBuffer(GL_ARRAY_BUFFER, env_vbo);
-
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-
-        // Floor
-        glUseProgram(floor_program);
-        glEnable(GL_DEPTH_TEST);
-
-        glUniformMatrix4fv(floor_model_location, 1, GL_FALSE, reinterpret_cast<float *>(&model));
-        glUniformMatrix4fv(floor_projection_location, 1, GL_FALSE, reinterpret_cast<float *>(&projection));
-        glUniformMatrix4fv(floor_view_location, 1, GL_FALSE, reinterpret_cast<float *>(&view));
-        glUniform3fv(floor_sun_direction_location, 1, reinterpret_cast<float *>(&light_direction));
-        glUniform3fv(floor_camera_position_location, 1, reinterpret_cast<float *>(&camera_position));
-        glUniform1i(floor_texture_location, 0);
-        glUniform1i(floor_caustics_texture_location, 2);
-        glUniform3f(floor_ambient_color_location, 0.2, 0.2, 0.2);
-        glUniform3f(floor_sun_color_location, sun_color.x, sun_color.y, sun_color.z);
-        glUniform1f(floor_glossiness_location, 3.0);
-        glUniform1f(floor_roughness_location, 0.05);
-
-        glBindVertexArray(floor_vao);
-        glBindBuffer(GL_ARRAY_BUFFER, floor_vbo);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, tex);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, caustics_tex);
-
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        // Water
-        glUseProgram(water_program);
-        glEnable(GL_DEPTH_TEST);
-
-        glUniformMatrix4fv(water_model_location, 1, GL_FALSE, reinterpret_cast<float *>(&model));
-        glUniformMatrix4fv(water_projection_location, 1, GL_FALSE, reinterpret_cast<float *>(&projection));
-        glUniformMatrix4fv(water_view_location, 1, GL_FALSE, reinterpret_cast<float *>(&view));
-        glUniform3fv(water_sun_direction_location, 1, reinterpret_cast<float *>(&light_direction));
-        glUniform3fv(water_camera_position_location, 1, reinterpret_cast<float *>(&camera_position));
-        glUniform1f(water_time_location, time);
-        glUniform3f(water_ambient_color_location, 0.2, 0.2, 0.2);
-        glUniform3f(water_sun_color_location, sun_color.x, sun_color.y, sun_color.z);
-        glUniform1f(water_glossiness_location, 3.0);
-        glUniform1f(water_roughness_location, 0.05);
-        glUniform1i(water_env_texture_location, 1);
-        glUniform1i(water_floor_texture_location, 0);
-        glUniform1i(water_caustics_texture_location, 2);
-        glUniform1f(water_floor_width_location, floor_width);
-        glUniform1f(water_floor_height_location, floor_height);
-
-        glBindVertexArray(water_vao);
-        glBindBuffer(GL_ARRAY_BUFFER, water_vbo);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, tex);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, env_tex);
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, caustics_tex);
-
-        glDrawArrays(GL_TRIANGLES, 0, water_points.size());
-
-        SDL_GL_SwapWindow(window);
+            camera.view_angle += 2.f * dt;
+
+        snapshots.back() = make_frame_snapshot(camera, scene, time, width, height);
+        snapshots.publish();
+
+        if (int percent = resolution_percent; percent != shown_resolution_percent || current_quality != shown_quality) {
+            shown_resolution_percent = percent;
+            shown_quality = current_quality;
+            std::string title = std::string("Water pool (") + quality_tier_name(*shown_quality) + " quality";
+            if (percent != 100)
+                title += ", " + std::to_string(percent) + "% resolution";
+            SDL_SetWindowTitle(window, (title + ")").c_str());
+        }
+
+        // Ticks once a millisecond, or as soon as there is input, so the render thread always
+        // picks up a fresh snapshot.
+        SDL_WaitEventTimeout(nullptr, 1);
     }
 
+    running = false;
+    render_thread.join();
+    if (render_error)
+        std::rethrow_exception(render_error);
+
     SDL_GL_DeleteContext(gl_context);
     SDL_DestroyWindow(window);
 }
@@ -0,0 +1,93 @@
+#include "mesh.hpp"
+
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/type_precision.hpp>
+#include <glm/vec4.hpp>
+
+#include <cmath>
+
+namespace
+{
+
+void bind_mesh(Mesh & mesh)
+{
+    if (!mesh.vao) {
+        glGenVertexArrays(1, &mesh.vao);
+        glGenBuffers(1, &mesh.vbo);
+    }
+    glBindVertexArray(mesh.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+}
+
+template <typename T>
+void upload_vertices(Mesh & mesh, const std::vector<T> & vertices)
+{
+    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(T), vertices.data(), GL_STATIC_DRAW);
+    mesh.vertex_count = vertices.size();
+    mesh.stride = sizeof(T);
+}
+
+}
+
+void upload_mesh(Mesh & mesh, const std::vector<Vertex> & vertices, bool packed)
+{
+    bind_mesh(mesh);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    if (!packed) {
+        upload_vertices(mesh, vertices);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(0));
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(12));
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)(24));
+        return;
+    }
+
+    std::vector<PackedVertex> packed_vertices;
+    for (auto const & vertex : vertices) {
+        PackedVertex & packed_vertex = packed_vertices.emplace_back();
+        packed_vertex.position = vertex.position;
+        packed_vertex.normal = glm::packSnorm3x10_1x2(glm::vec4(vertex.normal, 0.f));
+        packed_vertex.texcoord[0] = glm::packHalf1x16(vertex.texcoord.x);
+        packed_vertex.texcoord[1] = glm::packHalf1x16(vertex.texcoord.y);
+    }
+    upload_vertices(mesh, packed_vertices);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)(0));
+    glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)(12));
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)(16));
+}
+
+void upload_water_grid(Mesh & mesh, int width_cnt, int height_cnt, bool packed)
+{
+    // Neighbouring cells compute shared corners identically, so the quantized grid has no cracks.
+    auto corner = [&](int i, int j) {
+        return glm::vec2(float(i) / width_cnt, float(j) / height_cnt);
+    };
+    std::vector<glm::vec2> points;
+    points.reserve(std::size_t(width_cnt) * height_cnt * 6);
+    for (int i = 0; i < width_cnt; ++i) {
+        for (int j = 0; j < height_cnt; ++j) {
+            points.push_back(corner(i, j));
+            points.push_back(corner(i, j + 1));
+            points.push_back(corner(i + 1, j));
+            points.push_back(corner(i + 1, j));
+            points.push_back(corner(i, j + 1));
+            points.push_back(corner(i + 1, j + 1));
+        }
+    }
+
+    bind_mesh(mesh);
+    glEnableVertexAttribArray(0);
+    if (!packed) {
+        upload_vertices(mesh, points);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(glm::vec2), (void*)(0));
+        return;
+    }
+
+    std::vector<glm::u16vec2> quantized;
+    quantized.reserve(points.size());
+    for (auto const & point : points)
+        quantized.push_back(glm::u16vec2(glm::round(point * 65535.f)));
+    upload_vertices(mesh, quantized);
+    glVertexAttribPointer(0, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(glm::u16vec2), (void*)(0));
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Vertex {
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 texcoord;
+};
+
+// Vertex with the normal as signed normalized GL_INT_2_10_10_10_REV and half float texcoords,
+// 20 bytes instead of the 32 of Vertex.
+struct PackedVertex {
+    glm::vec3 position;
+    std::uint32_t normal;
+    std::uint16_t texcoord[2];
+};
+
+static_assert(sizeof(Vertex) == 32 && sizeof(PackedVertex) == 20);
+
+// Vertex array with one interleaved buffer, drawn with glDrawArrays.
+struct Mesh {
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    GLsizei vertex_count = 0;
+    GLsizei stride = 0;
+
+    // Bytes the vertex shader fetches per draw, without index reuse there is no vertex cache.
+    std::size_t fetch_bytes() const { return std::size_t(vertex_count) * stride; }
+};
+
+// Position, normal and texcoord at locations 0-2. Creates the vertex array and buffer on first
+// use and replaces the contents afterwards.
+void upload_mesh(Mesh & mesh, const std::vector<Vertex> & vertices, bool packed);
+
+// Two triangles per cell of a width_cnt x height_cnt grid, positions at location 0. Positions are
+// grid coordinates in [0, 1], as normalized unsigned shorts when packed and floats otherwise;
+// the water shaders scale them to the pool with water_scale and water_offset.
+void upload_water_grid(Mesh & mesh, int width_cnt, int height_cnt, bool packed);
@@ -0,0 +1,236 @@
+#include "poster.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+namespace
+{
+
+// Readbacks in flight before read_tile waits for the oldest one.
+const int readback_slots = 3;
+// Largest stored deflate block.
+const std::size_t max_stored_block = 65535;
+
+std::uint32_t crc32(const unsigned char * data, std::size_t size, std::uint32_t crc = 0)
+{
+    static const auto table = [] {
+        std::array<std::uint32_t, 256> table;
+        for (std::uint32_t i = 0; i < 256; ++i) {
+            std::uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return table;
+    }();
+
+    crc = ~crc;
+    for (std::size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+void append_u32_be(std::vector<unsigned char> & out, std::uint32_t value)
+{
+    for (int shift = 24; shift >= 0; shift -= 8)
+        out.push_back((value >> shift) & 0xff);
+}
+
+bool ends_with(const std::string & str, const std::string & suffix)
+{
+    return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}
+
+ImageWriter::ImageWriter(const std::string & path, int width, int height)
+    : out_(path, std::ios::binary)
+    , path_(path)
+    , width_(width)
+    , height_(height)
+    , png_(ends_with(path, ".png"))
+{
+    if (!out_)
+        throw std::runtime_error("Can't write " + path);
+
+    if (!png_) {
+        out_ << "P6\n" << width_ << " " << height_ << "\n255\n";
+        return;
+    }
+
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    out_.write(reinterpret_cast<const char *>(signature), sizeof(signature));
+
+    std::vector<unsigned char> header;
+    append_u32_be(header, width_);
+    append_u32_be(header, height_);
+    // 8-bit RGB, deflate, adaptive filtering, no interlace.
+    header.insert(header.end(), {8, 2, 0, 0, 0});
+    write_chunk("IHDR", header);
+}
+
+void ImageWriter::write_chunk(const char * type, const std::vector<unsigned char> & data)
+{
+    std::vector<unsigned char> chunk;
+    append_u32_be(chunk, data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    append_u32_be(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+    out_.write(reinterpret_cast<const char *>(chunk.data()), chunk.size());
+}
+
+void ImageWriter::write_rows(const unsigned char * rgb, int rows)
+{
+    std::size_t row_size = std::size_t(width_) * 3;
+    if (!png_) {
+        out_.write(reinterpret_cast<const char *>(rgb), row_size * rows);
+    } else {
+        // Every row starts with filter type 0 (none).
+        std::vector<unsigned char> filtered;
+        filtered.reserve((row_size + 1) * rows);
+        for (int row = 0; row < rows; ++row) {
+            filtered.push_back(0);
+            filtered.insert(filtered.end(), rgb + row * row_size, rgb + (row + 1) * row_size);
+        }
+        for (unsigned char byte : filtered) {
+            adler_a_ = (adler_a_ + byte) % 65521;
+            adler_b_ = (adler_b_ + adler_a_) % 65521;
+        }
+
+        // The zlib stream continues across IDAT chunks; the header goes before the first block.
+        std::vector<unsigned char> data;
+        if (rows_written_ == 0)
+            data.insert(data.end(), {0x78, 0x01});
+        for (std::size_t offset = 0; offset < filtered.size(); offset += max_stored_block) {
+            std::size_t size = std::min(max_stored_block, filtered.size() - offset);
+            data.push_back(0);
+            data.insert(data.end(), {std::uint8_t(size), std::uint8_t(size >> 8), std::uint8_t(~size), std::uint8_t(~size >> 8)});
+            data.insert(data.end(), filtered.begin() + offset, filtered.begin() + offset + size);
+        }
+        write_chunk("IDAT", data);
+    }
+    rows_written_ += rows;
+    if (!out_)
+        throw std::runtime_error("Can't write " + path_);
+}
+
+void ImageWriter::finish()
+{
+    if (rows_written_ != height_)
+        throw std::logic_error("ImageWriter: " + std::to_string(rows_written_) + " of " + std::to_string(height_) + " rows written");
+
+    if (png_) {
+        // Empty final block and the Adler-32 of the whole stream.
+        std::vector<unsigned char> data = {1, 0, 0, 0xff, 0xff};
+        append_u32_be(data, (adler_b_ << 16) | adler_a_);
+        write_chunk("IDAT", data);
+        write_chunk("IEND", {});
+    }
+    out_.close();
+    if (!out_)
+        throw std::runtime_error("Can't write " + path_);
+}
+
+Poster::Poster(const std::string & path, int width, int height, int tile_size)
+    : width_(width)
+    , height_(height)
+    , writer_(path, width, height)
+{
+    GLint max_texture_size = 0;
+    GLint max_viewport[2] = {0, 0};
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_texture_size);
+    glGetIntegerv(GL_MAX_VIEWPORT_DIMS, max_viewport);
+    tile_size_ = std::max(16, std::min({tile_size, int(max_texture_size), int(max_viewport[0]), int(max_viewport[1])}));
+
+    for (int top = height_; top > 0; top -= tile_size_) {
+        int bottom = std::max(0, top - tile_size_);
+        for (int x = 0; x < width_; x += tile_size_)
+            tiles_.push_back({x, bottom, std::min(tile_size_, width_ - x), top - bottom});
+    }
+
+    glGenTextures(1, &texture_);
+    glBindTexture(GL_TEXTURE_2D, texture_);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, tile_size_, tile_size_, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenFramebuffers(1, &framebuffer_);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture_, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    slots_.resize(readback_slots);
+    for (auto & slot : slots_) {
+        glGenBuffers(1, &slot.buffer);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, std::size_t(tile_size_) * tile_size_ * 3, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    band_.resize(std::size_t(width_) * tile_size_ * 3);
+}
+
+Poster::~Poster()
+{
+    for (auto & slot : slots_) {
+        if (slot.fence)
+            glDeleteSync(slot.fence);
+        glDeleteBuffers(1, &slot.buffer);
+    }
+    glDeleteFramebuffers(1, &framebuffer_);
+    glDeleteTextures(1, &texture_);
+}
+
+void Poster::read_tile(int index)
+{
+    if (int(pending_.size()) == readback_slots)
+        collect_oldest();
+
+    auto const & tile = tiles_.at(index);
+    auto & slot = slots_[next_slot_];
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer_);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, tile.width, tile.height, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot.tile = index;
+    pending_.push_back(next_slot_);
+    next_slot_ = (next_slot_ + 1) % readback_slots;
+}
+
+void Poster::collect_oldest()
+{
+    auto & slot = slots_[pending_.front()];
+    pending_.pop_front();
+    while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+        ;
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    auto const & tile = tiles_[slot.tile];
+    std::size_t row_size = std::size_t(tile.width) * 3;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (auto pixels = static_cast<const unsigned char *>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, row_size * tile.height, GL_MAP_READ_BIT))) {
+        // Tile rows come bottom-up, the band is stored top-down.
+        for (int row = 0; row < tile.height; ++row) {
+            std::size_t band_row = tile.height - 1 - row;
+            std::memcpy(band_.data() + (band_row * width_ + tile.x) * 3, pixels + row * row_size, row_size);
+        }
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    if (tile.x + tile.width == width_)
+        writer_.write_rows(band_.data(), tile.height);
+}
+
+void Poster::finish()
+{
+    while (!pending_.empty())
+        collect_oldest();
+    writer_.finish();
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Writes an RGB8 image row by row, top to bottom, so the whole image is never in memory. PNG
+// for a .png path (uncompressed deflate blocks, one IDAT chunk per write), binary PPM otherwise.
+class ImageWriter
+{
+public:
+    ImageWriter(const std::string & path, int width, int height);
+
+    ImageWriter(const ImageWriter &) = delete;
+    ImageWriter & operator=(const ImageWriter &) = delete;
+
+    // Appends rows of width * 3 bytes each.
+    void write_rows(const unsigned char * rgb, int rows);
+    // Writes the trailer once all rows are written.
+    void finish();
+
+private:
+    void write_chunk(const char * type, const std::vector<unsigned char> & data);
+
+    std::ofstream out_;
+    std::string path_;
+    int width_;
+    int height_;
+    int rows_written_ = 0;
+    bool png_;
+    std::uint32_t adler_a_ = 1;
+    std::uint32_t adler_b_ = 0;
+};
+
+// Renders an image of any size in tiles of at most tile_size pixels, e.g. larger than the
+// maximum framebuffer size. The caller renders every tile into tile_texture() with the
+// tile_transform() of the tile; read_tile() starts an asynchronous readback into a ring of
+// pixel pack buffers. Tiles go one band of tile rows at a time from the top, so only one band is
+// kept in memory and written out as soon as it's complete.
+class Poster
+{
+public:
+    struct Tile {
+        // Lower left corner in image pixels, y up.
+        int x;
+        int y;
+        int width;
+        int height;
+    };
+
+    Poster(const std::string & path, int width, int height, int tile_size);
+    ~Poster();
+
+    Poster(const Poster &) = delete;
+    Poster & operator=(const Poster &) = delete;
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int tile_size() const { return tile_size_; }
+    const std::vector<Tile> & tiles() const { return tiles_; }
+    GLuint tile_texture() const { return texture_; }
+
+    // Reads the lower left of tile_texture() once the given tile has been rendered into it.
+    void read_tile(int index);
+    // Waits for the remaining readbacks and completes the file.
+    void finish();
+
+private:
+    struct Slot {
+        GLuint buffer = 0;
+        GLsync fence = nullptr;
+        int tile = -1;
+    };
+
+    void collect_oldest();
+
+    int width_;
+    int height_;
+    int tile_size_;
+    std::vector<Tile> tiles_;
+    GLuint texture_ = 0;
+    GLuint framebuffer_ = 0;
+    std::vector<Slot> slots_;
+    std::deque<int> pending_;
+    int next_slot_ = 0;
+    // Current band, top row first.
+    std::vector<unsigned char> band_;
+    ImageWriter writer_;
+};
@@ -0,0 +1,169 @@
+#include "quality.hpp"
+#include "json.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+
+const char * const tier_names[] = {"low", "medium", "high", "ultra"};
+
+// Frames after a tier change that are not measured: the switch itself rebuilds programs and
+// buffers, and the first frames after it fill caches.
+const int warmup_frames = 10;
+// Every tier is measured for at least this long and this many frames.
+const double measure_seconds = 1.0;
+const int measure_frames = 10;
+// A tier has to leave some of the budget unused, views with more water on screen cost more.
+const double headroom = 0.85;
+
+std::string json_string(const std::string & str)
+{
+    std::string result = "\"";
+    for (char c : str) {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        if (static_cast<unsigned char>(c) >= 0x20)
+            result += c;
+    }
+    return result + "\"";
+}
+
+}
+
+QualitySettings quality_settings(QualityTier tier)
+{
+    switch (tier) {
+    case QualityTier::low:
+        return {0.25f, 0.5f, GL_RGBA8, 1.f, 1.f, 1, false, 0, 0.f, 1, 0};
+    case QualityTier::medium:
+        return {0.5f, 0.5f, GL_RGBA8, 0.5f, 4.f, 2, true, 1, 0.25f, 4, 4};
+    case QualityTier::high:
+        return {1.f, 1.f, GL_RGBA8, 0.f, 8.f, 3, true, 2, 0.5f, 2, 5};
+    case QualityTier::ultra:
+        // Half floats accumulate overlapping caustics without clipping at 1.
+        return {2.f, 2.f, GL_RGBA16F, 0.f, 16.f, 3, true, 2, 1.f, 1, 6};
+    }
+    throw std::logic_error("Unknown quality tier");
+}
+
+const char * quality_tier_name(QualityTier tier)
+{
+    return tier_names[int(tier)];
+}
+
+QualityTier parse_quality_tier(std::string_view name)
+{
+    for (int i = 0; i < 4; ++i) {
+        if (name == tier_names[i])
+            return QualityTier(i);
+    }
+    throw std::runtime_error("Unknown quality tier " + std::string(name) + ", expected low, medium, high or ultra");
+}
+
+std::optional<QualityTier> load_quality_tier(const std::string & path, const std::string & renderer)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return std::nullopt;
+    std::string text{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+
+    // A damaged file only means detecting the tier again.
+    try {
+        JsonValue root = parse_json(text);
+        std::optional<std::string> saved_renderer, tier;
+        for (auto const & [key, value] : root.object) {
+            if (value.type != JsonValue::Type::string)
+                continue;
+            if (key == "renderer")
+                saved_renderer = value.string;
+            else if (key == "tier")
+                tier = value.string;
+        }
+        if (saved_renderer == renderer && tier)
+            return parse_quality_tier(*tier);
+    } catch (const std::runtime_error &) {
+    }
+    return std::nullopt;
+}
+
+void save_quality_tier(const std::string & path, const std::string & renderer, QualityTier tier)
+{
+    std::ofstream out(path, std::ios::binary);
+    out << "{\n    \"renderer\": " << json_string(renderer) << ",\n    \"tier\": \"" << quality_tier_name(tier) << "\"\n}\n";
+    if (!out)
+        std::cerr << "Can't write " << path << ", the quality tier will be detected again next time" << std::endl;
+}
+
+QualityDetector::QualityDetector(double budget_milliseconds)
+    : budget_(budget_milliseconds)
+{}
+
+void QualityDetector::add_frame(long long frame, double cpu_milliseconds)
+{
+    if (finished_)
+        return;
+    if (++frames_seen_ <= warmup_frames)
+        return;
+    if (first_frame_ < 0) {
+        first_frame_ = frame;
+        measure_start_ = std::chrono::steady_clock::now();
+    }
+    cpu_milliseconds_[frame] = cpu_milliseconds;
+    evaluate();
+}
+
+void QualityDetector::add_gpu_results(const std::vector<GpuTimer::Result> & results)
+{
+    if (finished_)
+        return;
+    for (auto const & result : results) {
+        last_gpu_frame_ = std::max(last_gpu_frame_, result.frame);
+        if (first_frame_ >= 0 && result.frame >= first_frame_)
+            gpu_milliseconds_[result.frame] += result.milliseconds;
+    }
+    evaluate();
+}
+
+void QualityDetector::evaluate()
+{
+    if (first_frame_ < 0)
+        return;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - measure_start_).count();
+    if (seconds < measure_seconds)
+        return;
+
+    // Results arrive in submission order, so a frame's GPU time is complete once a later frame
+    // has results. Without timer queries the GPU time stays 0.
+    std::vector<double> frame_milliseconds;
+    for (auto const & [frame, cpu] : cpu_milliseconds_) {
+        if (frame >= last_gpu_frame_ && last_gpu_frame_ >= 0)
+            break;
+        auto gpu = gpu_milliseconds_.find(frame);
+        frame_milliseconds.push_back(std::max(cpu, gpu == gpu_milliseconds_.end() ? 0.0 : gpu->second));
+    }
+    if (int(frame_milliseconds.size()) < measure_frames)
+        return;
+
+    auto percentile = frame_milliseconds.begin() + frame_milliseconds.size() * 9 / 10;
+    std::nth_element(frame_milliseconds.begin(), percentile, frame_milliseconds.end());
+    measurements_[tier_] = *percentile;
+
+    bool holds = *percentile <= budget_ * headroom;
+    if (holds)
+        best_ = tier_;
+    if (!holds || tier_ == QualityTier::ultra) {
+        tier_ = best_;
+        finished_ = true;
+        return;
+    }
+
+    tier_ = QualityTier(int(tier_) + 1);
+    first_frame_ = -1;
+    frames_seen_ = 0;
+    cpu_milliseconds_.clear();
+    gpu_milliseconds_.clear();
+}
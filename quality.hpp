@@ -0,0 +1,78 @@
+#pragma once
+
+#include "gpu_timer.hpp"
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class QualityTier { low, medium, high, ultra };
+
+// Everything a tier bundles. Grid and caustics sizes scale the values of the scene file, so
+// scene.json describes the high tier.
+struct QualitySettings {
+    float grid_scale;
+    float caustics_scale;
+    GLenum caustics_format;
+    float mip_bias;
+    float anisotropy;
+    int wave_count;
+    bool caustics;
+    int shader_quality;
+    // Planar reflection size relative to the render size, 0 reflects only the sky, and the
+    // number of frames each reflection is reused for.
+    float reflection_scale;
+    int reflection_interval;
+    // Levels of the bloom chain, each half the size of the one before; 0 disables bloom.
+    int bloom_levels;
+};
+
+QualitySettings quality_settings(QualityTier tier);
+const char * quality_tier_name(QualityTier tier);
+QualityTier parse_quality_tier(std::string_view name);
+
+// The tier picked on an earlier run, if it was picked for the same renderer.
+std::optional<QualityTier> load_quality_tier(const std::string & path, const std::string & renderer);
+// A file that can't be written is reported on stderr: the next start just detects the tier again.
+void save_quality_tier(const std::string & path, const std::string & renderer, QualityTier tier);
+
+// Finds the highest tier that holds the frame budget while the program is used normally. It
+// starts at the lowest tier and measures each for about a second; the frame loop switches to
+// tier() whenever it changes. A frame costs the larger of its CPU submission time and its GPU
+// time, so a software rasterizer that draws on the CPU is measured as well.
+class QualityDetector
+{
+public:
+    explicit QualityDetector(double budget_milliseconds);
+
+    QualityTier tier() const { return tier_; }
+    bool finished() const { return finished_; }
+    // 90th percentile frame time of every tier measured so far.
+    const std::map<QualityTier, double> & measurements() const { return measurements_; }
+
+    // CPU time of a frame rendered with tier(); frame counts as in GpuTimer.
+    void add_frame(long long frame, double cpu_milliseconds);
+    void add_gpu_results(const std::vector<GpuTimer::Result> & results);
+
+private:
+    void evaluate();
+
+    double budget_;
+    QualityTier tier_ = QualityTier::low;
+    QualityTier best_ = QualityTier::low;
+    bool finished_ = false;
+    std::map<QualityTier, double> measurements_;
+
+    // Frames of the current tier, after the warm-up.
+    long long first_frame_ = -1;
+    int frames_seen_ = 0;
+    std::chrono::steady_clock::time_point measure_start_;
+    std::map<long long, double> cpu_milliseconds_;
+    std::map<long long, double> gpu_milliseconds_;
+    long long last_gpu_frame_ = -1;
+};
@@ -0,0 +1,58 @@
+#include "query_scopes.hpp"
+
+#include <stdexcept>
+
+QueryScopes::~QueryScopes()
+{
+    for (auto const & pending : pending_)
+        free_queries_.push_back(pending.query);
+    if (!free_queries_.empty())
+        glDeleteQueries(free_queries_.size(), free_queries_.data());
+}
+
+void QueryScopes::begin(const std::string & name, long long frame)
+{
+    if (active_)
+        throw std::logic_error("QueryScopes: nested scope " + name);
+
+    GLuint query;
+    if (free_queries_.empty()) {
+        glGenQueries(1, &query);
+    } else {
+        query = free_queries_.back();
+        free_queries_.pop_back();
+    }
+    glBeginQuery(target_, query);
+    pending_.push_back({query, name, frame});
+    active_ = true;
+}
+
+void QueryScopes::end()
+{
+    glEndQuery(target_);
+    active_ = false;
+}
+
+std::vector<QueryScopes::Result> QueryScopes::poll(bool wait)
+{
+    std::vector<Result> results;
+    std::size_t done = 0;
+    // Queries finish in submission order, so stop at the first one that isn't ready.
+    for (; done < pending_.size(); ++done) {
+        auto const & pending = pending_[done];
+        if (active_ && done + 1 == pending_.size())
+            break;
+        if (!wait) {
+            GLint available = 0;
+            glGetQueryObjectiv(pending.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                break;
+        }
+        GLuint64 value = 0;
+        glGetQueryObjectui64v(pending.query, GL_QUERY_RESULT, &value);
+        results.push_back({pending.name, pending.frame, value});
+        free_queries_.push_back(pending.query);
+    }
+    pending_.erase(pending_.begin(), pending_.begin() + done);
+    return results;
+}
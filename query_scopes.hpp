@@ -0,0 +1,45 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+
+// Non-blocking GL queries of one target (GL_TIME_ELAPSED, GL_SAMPLES_PASSED, ...) over named
+// scopes. Results arrive a few frames after the scope was submitted, so the frame loop never
+// waits for the GPU. Each scope is tagged with the frame number it was submitted in.
+class QueryScopes
+{
+public:
+    struct Result {
+        std::string name;
+        long long frame;
+        GLuint64 value;
+    };
+
+    explicit QueryScopes(GLenum target) : target_(target) {}
+    ~QueryScopes();
+
+    QueryScopes(const QueryScopes &) = delete;
+    QueryScopes & operator=(const QueryScopes &) = delete;
+
+    // Scopes can't nest: GL allows only one active query per target.
+    void begin(const std::string & name, long long frame);
+    void end();
+
+    // Returns the scopes whose results became available since the previous call.
+    // With wait set, blocks until every submitted scope is finished.
+    std::vector<Result> poll(bool wait = false);
+
+private:
+    struct Pending {
+        GLuint query;
+        std::string name;
+        long long frame;
+    };
+
+    GLenum target_;
+    std::vector<GLuint> free_queries_;
+    std::vector<Pending> pending_;
+    bool active_ = false;
+};
@@ -0,0 +1,323 @@
+#include "render_graph.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+
+// Pooled textures that no frame used for this many frames are deleted, e.g. after a resize.
+const int pool_unused_frames = 3;
+
+bool is_depth_format(GLenum format)
+{
+    return format == GL_DEPTH_COMPONENT16 || format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F;
+}
+
+}
+
+void RenderGraph::PassBuilder::read(Resource resource)
+{
+    graph_.passes_[pass_].reads.push_back(resource);
+    graph_.access(pass_, resource, false);
+}
+
+void RenderGraph::PassBuilder::write(Resource resource)
+{
+    graph_.passes_[pass_].colors.push_back(resource);
+    graph_.access(pass_, resource, true);
+}
+
+void RenderGraph::PassBuilder::depth(Resource resource)
+{
+    graph_.passes_[pass_].depth = resource;
+    graph_.access(pass_, resource, true);
+}
+
+void RenderGraph::PassBuilder::viewport(int width, int height)
+{
+    graph_.passes_[pass_].viewport_width = width;
+    graph_.passes_[pass_].viewport_height = height;
+}
+
+GLuint RenderGraph::PassContext::texture(Resource resource) const
+{
+    return graph_.resources_.at(resource).texture;
+}
+
+GLuint RenderGraph::PassContext::framebuffer(Resource resource) const
+{
+    auto const & node = graph_.resources_.at(resource);
+    if (node.kind == Kind::backbuffer || node.kind == Kind::backbuffer_depth)
+        return 0;
+    if (is_depth_format(node.desc.format))
+        return graph_.framebuffer_for({}, node.texture);
+    return graph_.framebuffer_for({node.texture}, 0);
+}
+
+RenderGraph::RenderGraph(GlState & state, GpuTimer & timer)
+    : state_(state)
+    , timer_(timer)
+{}
+
+RenderGraph::~RenderGraph()
+{
+    for (auto const & [attachments, framebuffer] : framebuffers_)
+        glDeleteFramebuffers(1, &framebuffer);
+    for (auto const & pooled : pool_)
+        glDeleteTextures(1, &pooled.texture);
+}
+
+RenderGraph::Resource RenderGraph::add_resource(std::string name, const TextureDesc & desc, Kind kind, GLuint texture)
+{
+    resources_.push_back({std::move(name), desc, kind, texture});
+    return resources_.size() - 1;
+}
+
+RenderGraph::Resource RenderGraph::create_texture(std::string name, const TextureDesc & desc)
+{
+    return add_resource(std::move(name), desc, Kind::transient, 0);
+}
+
+RenderGraph::Resource RenderGraph::import_texture(std::string name, GLuint texture, const TextureDesc & desc)
+{
+    return add_resource(std::move(name), desc, Kind::imported, texture);
+}
+
+RenderGraph::Resource RenderGraph::backbuffer(int width, int height)
+{
+    return add_resource("backbuffer", {width, height, GL_RGBA8}, Kind::backbuffer, 0);
+}
+
+RenderGraph::Resource RenderGraph::backbuffer_depth(int width, int height)
+{
+    return add_resource("backbuffer depth", {width, height, GL_DEPTH_COMPONENT24}, Kind::backbuffer_depth, 0);
+}
+
+void RenderGraph::access(int pass, Resource resource, bool write)
+{
+    auto & node = resources_.at(resource);
+    auto & dependencies = passes_[pass].dependencies;
+    if (node.last_writer >= 0 && node.last_writer != pass
+        && std::find(dependencies.begin(), dependencies.end(), node.last_writer) == dependencies.end())
+        dependencies.push_back(node.last_writer);
+    if (write) {
+        node.last_writer = pass;
+        if (node.kind != Kind::transient)
+            passes_[pass].output = true;
+    }
+}
+
+void RenderGraph::add_pass(std::string name, const std::function<void(PassBuilder &)> & setup,
+    std::function<void(const PassContext &)> execute)
+{
+    passes_.push_back({std::move(name), std::move(execute)});
+    PassBuilder builder(*this, passes_.size() - 1);
+    setup(builder);
+}
+
+GLuint RenderGraph::acquire(const TextureDesc & desc, bool & aliased)
+{
+    for (auto & pooled : pool_) {
+        if (!pooled.in_use && pooled.desc == desc) {
+            aliased = pooled.used_this_frame;
+            pooled.in_use = pooled.used_this_frame = true;
+            pooled.unused_frames = 0;
+            return pooled.texture;
+        }
+    }
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    if (desc.samples > 1) {
+        glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, texture);
+        glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, desc.samples, desc.format, desc.width, desc.height, GL_TRUE);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        if (is_depth_format(desc.format))
+            glTexImage2D(GL_TEXTURE_2D, 0, desc.format, desc.width, desc.height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+        else
+            glTexImage2D(GL_TEXTURE_2D, 0, desc.format, desc.width, desc.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+    // The texture binding changed behind the state tracker.
+    state_.invalidate();
+
+    pool_.push_back({texture, desc, 0, true, true});
+    aliased = false;
+    return texture;
+}
+
+void RenderGraph::release(GLuint texture)
+{
+    for (auto & pooled : pool_)
+        if (pooled.texture == texture)
+            pooled.in_use = false;
+}
+
+GLuint RenderGraph::framebuffer_for(const std::vector<GLuint> & colors, GLuint depth)
+{
+    auto key = colors;
+    key.push_back(depth);
+    if (auto it = framebuffers_.find(key); it != framebuffers_.end())
+        return it->second;
+
+    // Passes ask for blit sources while their own framebuffer is bound, so both bindings are
+    // restored afterwards.
+    GLint draw_framebuffer = 0, read_framebuffer = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &draw_framebuffer);
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &read_framebuffer);
+
+    GLuint framebuffer;
+    glGenFramebuffers(1, &framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    std::vector<GLenum> draw_buffers;
+    for (std::size_t i = 0; i < colors.size(); ++i) {
+        glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, colors[i], 0);
+        draw_buffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+    }
+    if (depth)
+        glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth, 0);
+    // Without color attachments the read buffer has to be GL_NONE too, or the framebuffer is
+    // incomplete as a blit source.
+    if (draw_buffers.empty()) {
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    } else
+        glDrawBuffers(draw_buffers.size(), draw_buffers.data());
+    if (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        throw std::runtime_error("Incomplete render graph framebuffer");
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, draw_framebuffer);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, read_framebuffer);
+
+    framebuffers_[key] = framebuffer;
+    return framebuffer;
+}
+
+GLuint RenderGraph::framebuffer_for(const PassNode & pass)
+{
+    bool backbuffer = false;
+    bool offscreen = false;
+    std::vector<GLuint> colors;
+    for (Resource color : pass.colors) {
+        auto const & node = resources_[color];
+        (node.kind == Kind::backbuffer ? backbuffer : offscreen) = true;
+        colors.push_back(node.texture);
+    }
+    GLuint depth = 0;
+    if (pass.depth >= 0) {
+        auto const & node = resources_[pass.depth];
+        (node.kind == Kind::backbuffer_depth ? backbuffer : offscreen) = true;
+        depth = node.texture;
+    }
+    if (backbuffer && offscreen)
+        throw std::logic_error("RenderGraph: pass " + pass.name + " mixes the default framebuffer with textures");
+    return backbuffer ? 0 : framebuffer_for(colors, depth);
+}
+
+void RenderGraph::trim_pool()
+{
+    bool deleted = false;
+    for (auto & pooled : pool_) {
+        if (!pooled.used_this_frame && ++pooled.unused_frames > pool_unused_frames) {
+            glDeleteTextures(1, &pooled.texture);
+            pooled.texture = 0;
+            deleted = true;
+        }
+        pooled.used_this_frame = false;
+        pooled.in_use = false;
+    }
+    if (!deleted)
+        return;
+    pool_.erase(std::remove_if(pool_.begin(), pool_.end(), [](auto const & pooled) { return pooled.texture == 0; }), pool_.end());
+    // Framebuffers may reference deleted textures; they are cheap to recreate.
+    for (auto const & [attachments, framebuffer] : framebuffers_)
+        glDeleteFramebuffers(1, &framebuffer);
+    framebuffers_.clear();
+    state_.invalidate();
+}
+
+void RenderGraph::execute()
+{
+    stats_ = {};
+    stats_.passes = passes_.size();
+    executed_.clear();
+
+    // Cull: keep the passes that outputs depend on, walking dependencies backwards.
+    for (int i = int(passes_.size()) - 1; i >= 0; --i) {
+        auto & pass = passes_[i];
+        if (pass.output)
+            pass.alive = true;
+        if (!pass.alive) {
+            ++stats_.culled;
+            continue;
+        }
+        for (int dependency : pass.dependencies)
+            passes_[dependency].alive = true;
+    }
+
+    // Lifetimes of transient textures among the surviving passes.
+    std::vector<int> first_use(resources_.size(), -1), last_use(resources_.size(), -1);
+    for (int i = 0; i < int(passes_.size()); ++i) {
+        auto const & pass = passes_[i];
+        if (!pass.alive)
+            continue;
+        auto use = [&](Resource resource) {
+            if (first_use[resource] < 0)
+                first_use[resource] = i;
+            last_use[resource] = i;
+        };
+        for (Resource resource : pass.reads)
+            use(resource);
+        for (Resource resource : pass.colors)
+            use(resource);
+        if (pass.depth >= 0)
+            use(pass.depth);
+    }
+
+    for (int i = 0; i < int(passes_.size()); ++i) {
+        auto & pass = passes_[i];
+        if (!pass.alive)
+            continue;
+
+        for (Resource r = 0; r < int(resources_.size()); ++r) {
+            if (first_use[r] != i || resources_[r].kind != Kind::transient)
+                continue;
+            bool aliased;
+            resources_[r].texture = acquire(resources_[r].desc, aliased);
+            ++stats_.transient_textures;
+            stats_.aliased += aliased;
+        }
+
+        int width = pass.viewport_width;
+        int height = pass.viewport_height;
+        if (width == 0) {
+            Resource attachment = pass.colors.empty() ? pass.depth : pass.colors.front();
+            if (attachment >= 0) {
+                width = resources_[attachment].desc.width;
+                height = resources_[attachment].desc.height;
+            }
+        }
+        if (!pass.colors.empty() || pass.depth >= 0) {
+            state_.bind_draw_framebuffer(framebuffer_for(pass));
+            state_.viewport(0, 0, width, height);
+        }
+
+        timer_.begin(pass.name);
+        pass.execute(PassContext(*this, width, height));
+        timer_.end();
+        executed_.push_back(pass.name);
+
+        for (Resource r = 0; r < int(resources_.size()); ++r)
+            if (last_use[r] == i && resources_[r].kind == Kind::transient)
+                release(resources_[r].texture);
+    }
+
+    trim_pool();
+    resources_.clear();
+    passes_.clear();
+}
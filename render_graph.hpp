@@ -0,0 +1,150 @@
+#pragma once
+
+#include "gl_state.hpp"
+#include "gpu_timer.hpp"
+
+#include <GL/glew.h>
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+struct TextureDesc {
+    int width = 0;
+    int height = 0;
+    GLenum format = GL_RGBA8;
+    // Multisampled textures can only be attached and blitted from, not sampled.
+    int samples = 1;
+
+    bool operator==(const TextureDesc &) const = default;
+};
+
+// Frame described as passes that declare the textures they read and write. The graph is
+// declared again every frame: passes whose results nobody consumes are culled, transient
+// textures come from a pool that outlives the frame, and transients whose lifetimes don't
+// overlap share the same texture. Every executed pass is timed with the GpuTimer under its
+// name and runs with its framebuffer and viewport already bound.
+//
+// Passes execute in declaration order, and dependencies are derived from it: reading or
+// writing a texture depends on its previous writer.
+class RenderGraph
+{
+public:
+    using Resource = int;
+
+    class PassBuilder
+    {
+    public:
+        void read(Resource resource);
+        // Color attachments, in attachment order.
+        void write(Resource resource);
+        void depth(Resource resource);
+        // Defaults to the size of the attachments.
+        void viewport(int width, int height);
+
+    private:
+        friend class RenderGraph;
+        PassBuilder(RenderGraph & graph, int pass) : graph_(graph), pass_(pass) {}
+
+        RenderGraph & graph_;
+        int pass_;
+    };
+
+    class PassContext
+    {
+    public:
+        GLuint texture(Resource resource) const;
+        // Framebuffer with only this texture attached, e.g. as a glBlitFramebuffer source.
+        GLuint framebuffer(Resource resource) const;
+        int width() const { return width_; }
+        int height() const { return height_; }
+
+    private:
+        friend class RenderGraph;
+        PassContext(RenderGraph & graph, int width, int height) : graph_(graph), width_(width), height_(height) {}
+
+        RenderGraph & graph_;
+        int width_;
+        int height_;
+    };
+
+    struct Stats {
+        int passes = 0;
+        int culled = 0;
+        int transient_textures = 0;
+        // Transient textures that reused a texture released earlier in the same frame.
+        int aliased = 0;
+    };
+
+    RenderGraph(GlState & state, GpuTimer & timer);
+    ~RenderGraph();
+
+    RenderGraph(const RenderGraph &) = delete;
+    RenderGraph & operator=(const RenderGraph &) = delete;
+
+    Resource create_texture(std::string name, const TextureDesc & desc);
+    // External textures and the default framebuffer are outputs: their writers are never culled.
+    Resource import_texture(std::string name, GLuint texture, const TextureDesc & desc);
+    Resource backbuffer(int width, int height);
+    Resource backbuffer_depth(int width, int height);
+
+    void add_pass(std::string name, const std::function<void(PassBuilder &)> & setup,
+        std::function<void(const PassContext &)> execute);
+
+    // Runs the declared frame and clears the declarations for the next one.
+    void execute();
+
+    const Stats & stats() const { return stats_; }
+    // Executed passes of the last frame, in order.
+    const std::vector<std::string> & executed_passes() const { return executed_; }
+
+private:
+    enum class Kind { transient, imported, backbuffer, backbuffer_depth };
+
+    struct ResourceNode {
+        std::string name;
+        TextureDesc desc;
+        Kind kind;
+        GLuint texture = 0;
+        int last_writer = -1;
+    };
+
+    struct PassNode {
+        std::string name;
+        std::function<void(const PassContext &)> execute;
+        std::vector<Resource> reads;
+        std::vector<Resource> colors;
+        Resource depth = -1;
+        int viewport_width = 0;
+        int viewport_height = 0;
+        std::vector<int> dependencies;
+        bool output = false;
+        bool alive = false;
+    };
+
+    struct PooledTexture {
+        GLuint texture;
+        TextureDesc desc;
+        int unused_frames = 0;
+        bool in_use = false;
+        bool used_this_frame = false;
+    };
+
+    Resource add_resource(std::string name, const TextureDesc & desc, Kind kind, GLuint texture);
+    void access(int pass, Resource resource, bool write);
+    GLuint acquire(const TextureDesc & desc, bool & aliased);
+    void release(GLuint texture);
+    GLuint framebuffer_for(const PassNode & pass);
+    GLuint framebuffer_for(const std::vector<GLuint> & colors, GLuint depth);
+    void trim_pool();
+
+    GlState & state_;
+    GpuTimer & timer_;
+    std::vector<ResourceNode> resources_;
+    std::vector<PassNode> passes_;
+    std::vector<PooledTexture> pool_;
+    std::map<std::vector<GLuint>, GLuint> framebuffers_;
+    std::vector<std::string> executed_;
+    Stats stats_;
+};
@@ -0,0 +1,165 @@
+#include "scene_config.hpp"
+#include "json.hpp"
+
+#include <glm/geometric.hpp>
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+
+// Larger grids and caustics textures are almost certainly typos.
+const int max_water_cnt = 4096;
+const int max_caustics_resolution = 4096;
+
+class SceneReader
+{
+public:
+    explicit SceneReader(std::string path)
+        : path_(std::move(path))
+    {}
+
+    [[noreturn]] void fail(const JsonValue & value, const std::string & name, const std::string & message) const
+    {
+        throw std::runtime_error(path_ + ":" + std::to_string(value.line) + ": " + name + " " + message);
+    }
+
+    void unknown_key(const JsonValue & value, const std::string & name) const
+    {
+        std::cerr << path_ << ":" << value.line << ": unknown key " << name << " ignored" << std::endl;
+    }
+
+    double number(const JsonValue & value, const std::string & name) const
+    {
+        if (value.type != JsonValue::Type::number)
+            fail(value, name, std::string("must be a number, got ") + value.type_name());
+        return value.number;
+    }
+
+    float number_at_least(const JsonValue & value, const std::string & name, double min, bool inclusive) const
+    {
+        double number = this->number(value, name);
+        if (inclusive ? number < min : number <= min)
+            fail(value, name, std::string("must be ") + (inclusive ? "at least " : "greater than ") + format(min) + ", got " + format(number));
+        return float(number);
+    }
+
+    int integer(const JsonValue & value, const std::string & name, int min, int max) const
+    {
+        double number = this->number(value, name);
+        if (number != std::floor(number) || number < min || number > max)
+            fail(value, name, "must be an integer from " + std::to_string(min) + " to " + std::to_string(max) + ", got " + format(number));
+        return int(number);
+    }
+
+    glm::vec3 vec3(const JsonValue & value, const std::string & name) const
+    {
+        if (value.type != JsonValue::Type::array || value.array.size() != 3)
+            fail(value, name, "must be an array of 3 numbers");
+        glm::vec3 result;
+        for (int i = 0; i < 3; ++i)
+            result[i] = float(number(value.array[i], name + "[" + std::to_string(i) + "]"));
+        return result;
+    }
+
+    glm::vec3 color(const JsonValue & value, const std::string & name) const
+    {
+        glm::vec3 result = vec3(value, name);
+        if (result.r < 0.f || result.g < 0.f || result.b < 0.f)
+            fail(value, name, "must not be negative");
+        return result;
+    }
+
+    MaterialConfig material(const JsonValue & value, const std::string & name, MaterialConfig material) const
+    {
+        if (value.type != JsonValue::Type::object)
+            fail(value, name, std::string("must be an object, got ") + value.type_name());
+        for (auto const & [key, member] : value.object) {
+            std::string member_name = name + "." + key;
+            if (key == "glossiness") {
+                material.glossiness = number_at_least(member, member_name, 0.0, true);
+            } else if (key == "roughness") {
+                // The specular exponent is 1 / roughness^2 - 1.
+                material.roughness = number_at_least(member, member_name, 0.0, false);
+                if (material.roughness > 1.f)
+                    fail(member, member_name, "must be at most 1, got " + format(member.number));
+            } else {
+                unknown_key(member, member_name);
+            }
+        }
+        return material;
+    }
+
+private:
+    static std::string format(double number)
+    {
+        std::ostringstream out;
+        out << number;
+        return out.str();
+    }
+
+    std::string path_;
+};
+
+}
+
+SceneConfig load_scene_config(const std::string & path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        throw std::runtime_error("Can't read " + path);
+    std::string text{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+
+    JsonValue root;
+    try {
+        root = parse_json(text);
+    } catch (const std::runtime_error & e) {
+        throw std::runtime_error(path + ": " + e.what());
+    }
+
+    SceneReader reader(path);
+    if (root.type != JsonValue::Type::object)
+        reader.fail(root, "the scene", std::string("must be an object, got ") + root.type_name());
+
+    SceneConfig scene;
+    for (auto const & [key, value] : root.object) {
+        if (key == "floor_width")
+            scene.floor_width = reader.number_at_least(value, key, 0.0, false);
+        else if (key == "floor_height")
+            scene.floor_height = reader.number_at_least(value, key, 0.0, false);
+        else if (key == "width_water_cnt")
+            scene.width_water_cnt = reader.integer(value, key, 1, max_water_cnt);
+        else if (key == "height_water_cnt")
+            scene.height_water_cnt = reader.integer(value, key, 1, max_water_cnt);
+        else if (key == "caustics_resolution")
+            scene.caustics_resolution = reader.integer(value, key, 16, max_caustics_resolution);
+        else if (key == "sun_direction") {
+            scene.sun_direction = reader.vec3(value, key);
+            // The caustics refract the sun through the surface, it has to shine from above.
+            if (scene.sun_direction.y <= 0.f)
+                reader.fail(value, key, "must point up (positive y)");
+        }
+        else if (key == "sun_light")
+            scene.sun_light = reader.color(value, key);
+        else if (key == "ambient_light")
+            scene.ambient_light = reader.color(value, key);
+        else if (key == "exposure")
+            scene.exposure = reader.number_at_least(value, key, 0.0, false);
+        else if (key == "bloom_threshold")
+            scene.bloom_threshold = reader.number_at_least(value, key, 0.0, true);
+        else if (key == "bloom_strength")
+            scene.bloom_strength = reader.number_at_least(value, key, 0.0, true);
+        else if (key == "floor_material")
+            scene.floor_material = reader.material(value, key, scene.floor_material);
+        else if (key == "water_material")
+            scene.water_material = reader.material(value, key, scene.water_material);
+        else
+            reader.unknown_key(value, key);
+    }
+    scene.sun_direction = glm::normalize(scene.sun_direction);
+    return scene;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <glm/vec3.hpp>
+
+#include <string>
+
+struct MaterialConfig {
+    float glossiness = 3.f;
+    float roughness = 0.05f;
+};
+
+// Pool size, water grid density and lighting. Defaults are the built-in scene; scene.json
+// overrides any subset of them, so quality and cost can be tuned per machine without a rebuild.
+struct SceneConfig {
+    float floor_width = 40.f;
+    float floor_height = 8.f;
+    int width_water_cnt = 500;
+    int height_water_cnt = 100;
+    int caustics_resolution = 512;
+    // Normalized when loaded.
+    glm::vec3 sun_direction{0.9f, 1.f, -0.2f};
+    glm::vec3 sun_light{1.f, 0.9f, 0.8f};
+    // Scales the irradiance of the environment cubemap; the sky photo isn't in the sun's units.
+    glm::vec3 ambient_light{0.3f};
+    // Scales the linear scene before the filmic curve maps it to the display.
+    float exposure = 1.f;
+    // Linear brightness above which the scene blooms, and how much of the bloom is added.
+    float bloom_threshold = 1.f;
+    float bloom_strength = 0.2f;
+    MaterialConfig floor_material;
+    MaterialConfig water_material;
+};
+
+// Reads a scene file. Unknown keys are reported on stderr and ignored; malformed JSON and
+// out-of-range values throw std::runtime_error naming the file and line.
+SceneConfig load_scene_config(const std::string & path);
@@ -0,0 +1,377 @@
+#include "shader.hpp"
+
+#include <shaders_embedded.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+
+void check_shader_compile(GLuint shader)
+{
+    GLint status;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+        GLint info_log_length;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &info_log_length);
+        std::string info_log(info_log_length, '\0');
+        glGetShaderInfoLog(shader, info_log.size(), nullptr, info_log.data());
+        throw std::runtime_error("Shader compilation failed: " + info_log);
+    }
+}
+
+GLuint submit_shader(GLenum type, const char * source)
+{
+    GLuint result = glCreateShader(type);
+    glShaderSource(result, 1, &source, nullptr);
+    glCompileShader(result);
+    return result;
+}
+
+}
+
+GLuint create_shader(GLenum type, const char * source)
+{
+    GLuint result = submit_shader(type, source);
+    check_shader_compile(result);
+    return result;
+}
+
+void check_program_link(GLuint program)
+{
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+        GLint info_log_length;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &info_log_length);
+        std::string info_log(info_log_length, '\0');
+        glGetProgramInfoLog(program, info_log.size(), nullptr, info_log.data());
+        throw std::runtime_error("Program linkage failed: " + info_log);
+    }
+}
+
+namespace
+{
+
+const char binary_magic[4] = {'W', 'P', 'P', 'B'};
+
+std::uint64_t fnv1a(std::uint64_t hash, const std::string & data)
+{
+    for (unsigned char c : data)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+}
+
+ProgramCache::ProgramCache(std::string directory)
+    : directory_(std::move(directory))
+{
+    if (GLEW_KHR_parallel_shader_compile)
+    {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        parallel_ = true;
+    }
+    else if (GLEW_ARB_parallel_shader_compile)
+    {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+        parallel_ = true;
+    }
+
+    GLint formats = 0;
+    if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary)
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    if (formats == 0)
+        directory_.clear();
+    if (directory_.empty())
+        return;
+    formats_.resize(formats);
+    glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats_.data());
+
+    std::error_code error;
+    std::filesystem::create_directories(directory_, error);
+    if (error)
+        directory_.clear();
+
+    for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+        driver_ += reinterpret_cast<const char *>(glGetString(name)) + std::string("\n");
+}
+
+std::string ProgramCache::binary_path(const std::vector<ShaderSource> & stages) const
+{
+    std::uint64_t hash = fnv1a(14695981039346656037ull, driver_);
+    for (auto const & stage : stages)
+        hash = fnv1a(fnv1a(hash, std::to_string(stage.type)), stage.source);
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(hash));
+    return (std::filesystem::path(directory_) / name).string();
+}
+
+bool ProgramCache::load_binary(GLuint program, const std::string & path) const
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return false;
+    std::vector<char> data{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    if (data.size() <= sizeof(binary_magic) + sizeof(GLenum) || !std::equal(binary_magic, binary_magic + 4, data.begin()))
+        return false;
+
+    GLenum format;
+    std::copy_n(data.data() + sizeof(binary_magic), sizeof(format), reinterpret_cast<char *>(&format));
+    if (std::find(formats_.begin(), formats_.end(), GLint(format)) == formats_.end())
+        return false;
+    std::size_t header = sizeof(binary_magic) + sizeof(format);
+    glProgramBinary(program, format, data.data() + header, data.size() - header);
+
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    return status == GL_TRUE;
+}
+
+void ProgramCache::store_binary(GLuint program, const std::string & path) const
+{
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return;
+    std::vector<char> data(length);
+    GLenum format;
+    glGetProgramBinary(program, length, nullptr, &format, data.data());
+
+    // Write to a temporary file first so that a concurrent start never sees a partial binary.
+    std::string temporary_path = path + ".tmp";
+    {
+        std::ofstream out(temporary_path, std::ios::binary);
+        out.write(binary_magic, sizeof(binary_magic));
+        out.write(reinterpret_cast<const char *>(&format), sizeof(format));
+        out.write(data.data(), data.size());
+        if (!out)
+            return;
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary_path, path, error);
+}
+
+PendingProgram ProgramCache::submit_program(const std::vector<ShaderSource> & stages)
+{
+    PendingProgram pending;
+    pending.program = glCreateProgram();
+
+    std::string path = directory_.empty() ? std::string() : binary_path(stages);
+    if (!path.empty())
+    {
+        if (load_binary(pending.program, path))
+        {
+            ++hits_;
+            pending.finished = true;
+            return pending;
+        }
+        // Rejected binaries (e.g. after a driver update with the same version string) are rebuilt.
+        std::error_code error;
+        std::filesystem::remove(path, error);
+        glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        pending.binary_path = path;
+    }
+    ++misses_;
+
+    for (auto const & stage : stages)
+        pending.shaders.push_back(submit_shader(stage.type, stage.source.c_str()));
+    for (GLuint shader : pending.shaders)
+        glAttachShader(pending.program, shader);
+    glLinkProgram(pending.program);
+    return pending;
+}
+
+bool ProgramCache::is_complete(const PendingProgram & pending) const
+{
+    if (pending.finished || !parallel_)
+        return true;
+    GLint complete = GL_TRUE;
+    glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &complete);
+    return complete == GL_TRUE;
+}
+
+void ProgramCache::finish_program(PendingProgram & pending)
+{
+    if (pending.finished)
+        return;
+    pending.finished = true;
+
+    // Compile errors are more useful than the link error they cause.
+    for (GLuint shader : pending.shaders)
+        check_shader_compile(shader);
+    check_program_link(pending.program);
+    for (GLuint shader : pending.shaders)
+    {
+        glDetachShader(pending.program, shader);
+        glDeleteShader(shader);
+    }
+    pending.shaders.clear();
+
+    if (!pending.binary_path.empty())
+        store_binary(pending.program, pending.binary_path);
+}
+
+void ProgramCache::finish_programs(const std::vector<PendingProgram *> & programs)
+{
+    std::vector<PendingProgram *> remaining = programs;
+    while (!remaining.empty())
+    {
+        auto complete = std::find_if(remaining.begin(), remaining.end(), [this](PendingProgram * pending) {
+            return is_complete(*pending);
+        });
+        if (complete == remaining.end())
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        finish_program(**complete);
+        remaining.erase(complete);
+    }
+}
+
+GLuint ProgramCache::create_program(const std::vector<ShaderSource> & stages)
+{
+    PendingProgram pending = submit_program(stages);
+    finish_programs({&pending});
+    return pending.program;
+}
+
+ShaderLibrary::ShaderLibrary(std::string directory)
+    : directory_(std::move(directory))
+{}
+
+std::string ShaderLibrary::source(const std::string & name) const
+{
+    std::ifstream in(std::filesystem::path(directory_) / name, std::ios::binary);
+    if (in)
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+
+    auto it = embedded_shaders.find(name);
+    if (it == embedded_shaders.end())
+        throw std::runtime_error("Unknown shader " + name);
+    return std::string(it->second);
+}
+
+namespace
+{
+
+std::string trim_left(const std::string & line)
+{
+    auto start = line.find_first_not_of(" \t");
+    return start == std::string::npos ? std::string() : line.substr(start);
+}
+
+}
+
+std::string ShaderLibrary::preprocess(const std::string & name, const std::string & defines, std::vector<std::string> & files) const
+{
+    std::string result;
+    expand(name, defines, files, result);
+    return result;
+}
+
+void ShaderLibrary::expand(const std::string & name, const std::string & defines, std::vector<std::string> & files, std::string & out) const
+{
+    std::size_t index = files.size();
+    files.push_back(name);
+
+    std::istringstream in(source(name));
+    std::string line;
+    for (int line_number = 1; std::getline(in, line); ++line_number) {
+        auto directive = trim_left(line);
+        if (directive.rfind("#version", 0) == 0 && index == 0) {
+            out += line + "\n" + defines;
+            out += "#line " + std::to_string(line_number + 1) + " 0\n";
+        } else if (directive.rfind("#include", 0) == 0) {
+            auto open = directive.find('"');
+            auto close = directive.find('"', open + 1);
+            if (open == std::string::npos || close == std::string::npos)
+                throw std::runtime_error(name + ":" + std::to_string(line_number) + ": malformed #include");
+            auto include = directive.substr(open + 1, close - open - 1);
+            if (std::find(files.begin(), files.end(), include) == files.end()) {
+                out += "#line 1 " + std::to_string(files.size()) + "\n";
+                expand(include, defines, files, out);
+                out += "#line " + std::to_string(line_number + 1) + " " + std::to_string(index) + "\n";
+            } else {
+                out += "\n";
+            }
+        } else {
+            out += line + "\n";
+        }
+    }
+}
+
+std::string ShaderVariant::defines() const
+{
+    return "#define WAVE_COUNT " + std::to_string(wave_count) + "\n"
+        + "#define CAUSTICS " + std::to_string(int(caustics)) + "\n"
+        + "#define QUALITY " + std::to_string(quality) + "\n"
+        + "#define PLANAR_REFLECTION " + std::to_string(int(planar_reflection)) + "\n"
+        + "#define TEMPORAL_AA " + std::to_string(int(temporal_aa)) + "\n"
+        + "#define BLOOM " + std::to_string(int(bloom)) + "\n";
+}
+
+std::string ShaderVariant::key() const
+{
+    return "waves " + std::to_string(wave_count) + (caustics ? ", caustics" : ", no caustics") + ", quality " + std::to_string(quality)
+        + (bloom ? ", bloom" : "") + (temporal_aa ? ", TAA" : "") + (planar_reflection ? ", planar reflection" : "");
+}
+
+bool ShaderProgram::uses(const std::string & file) const
+{
+    return std::find(files.begin(), files.end(), file) != files.end();
+}
+
+std::vector<ShaderSource> ShaderProgram::sources(const ShaderLibrary & library, const ShaderVariant & variant)
+{
+    std::vector<ShaderSource> result;
+    std::vector<std::string> used;
+    for (auto const & [type, name] : stages) {
+        std::vector<std::string> stage_files;
+        result.push_back({type, library.preprocess(name, variant.defines() + defines, stage_files)});
+        used.insert(used.end(), stage_files.begin(), stage_files.end());
+    }
+    files = std::move(used);
+    return result;
+}
+
+bool reload_program(ProgramCache & cache, const ShaderLibrary & library, const ShaderVariant & variant, ShaderProgram & program)
+{
+    PendingProgram pending;
+    try
+    {
+        pending = cache.submit_program(program.sources(library, variant));
+        cache.finish_programs({&pending});
+    }
+    catch (std::exception const & e)
+    {
+        for (GLuint shader : pending.shaders)
+            glDeleteShader(shader);
+        if (pending.program)
+            glDeleteProgram(pending.program);
+        std::cerr << "Keeping the previous program: " << e.what() << std::endl;
+        return false;
+    }
+
+    glDeleteProgram(program.id);
+    program.id = pending.program;
+    if (program.resolve)
+        program.resolve(program.id);
+    return true;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+GLuint create_shader(GLenum type, const char * source);
+
+// Throws with the info log if the program failed to link.
+void check_program_link(GLuint program);
+
+template <typename ... Shaders>
+GLuint create_program(Shaders ... shaders)
+{
+    GLuint result = glCreateProgram();
+    (glAttachShader(result, shaders), ...);
+    glLinkProgram(result);
+    check_program_link(result);
+    return result;
+}
+
+struct ShaderSource {
+    GLenum type;
+    std::string source;
+};
+
+// Program whose compilation and linking may still be running on driver threads.
+struct PendingProgram {
+    GLuint program = 0;
+    std::vector<GLuint> shaders;
+    std::string binary_path;
+    bool finished = false;
+};
+
+// Keeps linked program binaries (glGetProgramBinary) on disk, keyed by a hash of the shader
+// sources and the driver identification, so later startups skip compilation entirely.
+// Binaries the driver rejects are dropped and the program is compiled from source instead.
+class ProgramCache
+{
+public:
+    // An empty directory or a driver without binary formats disables the cache.
+    // Also lets the driver use all its compiler threads when KHR_parallel_shader_compile is present.
+    explicit ProgramCache(std::string directory);
+
+    // Starts compiling and linking without querying any status, so that several programs
+    // are in flight at once and the caller can do other work meanwhile.
+    PendingProgram submit_program(const std::vector<ShaderSource> & stages);
+
+    // Non-blocking with GL_COMPLETION_STATUS_KHR, otherwise always true.
+    bool is_complete(const PendingProgram & pending) const;
+
+    // Finishes the programs in the order the driver completes them: checks compile and link
+    // status (throwing with the info log) and stores the binaries of freshly linked programs.
+    void finish_programs(const std::vector<PendingProgram *> & programs);
+
+    GLuint create_program(const std::vector<ShaderSource> & stages);
+
+    int hits() const { return hits_; }
+    int misses() const { return misses_; }
+
+private:
+    std::string binary_path(const std::vector<ShaderSource> & stages) const;
+    bool load_binary(GLuint program, const std::string & path) const;
+    void store_binary(GLuint program, const std::string & path) const;
+    void finish_program(PendingProgram & pending);
+
+    std::string directory_;
+    std::string driver_;
+    std::vector<GLint> formats_;
+    int hits_ = 0;
+    int misses_ = 0;
+    bool parallel_ = false;
+};
+
+// Shader sources read from a directory, falling back to the copies embedded at build time
+// when a file is missing (e.g. when the executable runs without the source tree).
+class ShaderLibrary
+{
+public:
+    explicit ShaderLibrary(std::string directory);
+
+    std::string source(const std::string & name) const;
+    const std::string & directory() const { return directory_; }
+
+    // Expands #include "file" directives (every file is included once) and inserts the
+    // defines right after the #version line. The files the result was built from are
+    // appended to files; #line directives number them in that order, so an error at
+    // "1:12" refers to line 12 of files[1].
+    std::string preprocess(const std::string & name, const std::string & defines, std::vector<std::string> & files) const;
+
+private:
+    void expand(const std::string & name, const std::string & defines, std::vector<std::string> & files, std::string & out) const;
+
+    std::string directory_;
+};
+
+// Compile-time feature set of the shaders. Every combination is a separate set of programs,
+// so disabled features cost nothing at runtime.
+struct ShaderVariant {
+    int wave_count = 3; // 1-3 summed waves in the water height field
+    bool caustics = true;
+    int quality = 2; // 0 disables the floor specular highlight
+    bool planar_reflection = true; // otherwise the water reflects the prefiltered sky
+    bool temporal_aa = true; // scene programs also write screen motion to location 1
+    bool bloom = true; // the tonemapping adds the bloom chain
+
+    std::string defines() const;
+    std::string key() const;
+};
+
+// Program built from library files that is rebuilt when one of them changes.
+struct ShaderProgram {
+    std::vector<std::pair<GLenum, std::string>> stages;
+    // Sets up uniform blocks and samplers, called after every successful (re)link.
+    std::function<void(GLuint)> resolve;
+    // Added to the variant defines, e.g. to build a depth-only version of a shader.
+    std::string defines;
+    GLuint id = 0;
+    // Stage files and everything they include, as of the last build.
+    std::vector<std::string> files;
+
+    bool uses(const std::string & file) const;
+    std::vector<ShaderSource> sources(const ShaderLibrary & library, const ShaderVariant & variant);
+};
+
+// Rebuilds the program from the current sources. On failure the error is printed and the
+// previous program stays in use.
+bool reload_program(ProgramCache & cache, const ShaderLibrary & library, const ShaderVariant & variant, ShaderProgram & program);
@@ -0,0 +1,90 @@
+#include "shader_watcher.hpp"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+// Modification time polling is only the fallback, there is no need to hit the disk every frame.
+const auto scan_interval = std::chrono::milliseconds(250);
+
+}
+
+ShaderWatcher::ShaderWatcher(std::string directory)
+    : directory_(std::move(directory))
+{
+#ifdef __linux__
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    // Editors either rewrite the file in place or write a temporary file and rename it over.
+    if (fd_ >= 0 && inotify_add_watch(fd_, directory_.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    {
+        close(fd_);
+        fd_ = -1;
+    }
+    if (fd_ >= 0)
+        return;
+#endif
+    std::error_code error;
+    for (auto const & entry : std::filesystem::directory_iterator(directory_, error))
+        modified_[entry.path().filename().string()] = entry.last_write_time(error);
+    last_scan_ = std::chrono::steady_clock::now();
+}
+
+ShaderWatcher::~ShaderWatcher()
+{
+#ifdef __linux__
+    if (fd_ >= 0)
+        close(fd_);
+#endif
+}
+
+std::vector<std::string> ShaderWatcher::poll()
+{
+    std::vector<std::string> changed;
+    auto add = [&](std::string name) {
+        if (std::find(changed.begin(), changed.end(), name) == changed.end())
+            changed.push_back(std::move(name));
+    };
+
+#ifdef __linux__
+    if (fd_ >= 0)
+    {
+        alignas(inotify_event) char buffer[4096];
+        for (ssize_t length; (length = read(fd_, buffer, sizeof(buffer))) > 0;)
+        {
+            for (char * ptr = buffer; ptr < buffer + length;)
+            {
+                auto event = reinterpret_cast<const inotify_event *>(ptr);
+                if (event->len > 0)
+                    add(event->name);
+                ptr += sizeof(inotify_event) + event->len;
+            }
+        }
+        return changed;
+    }
+#endif
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - last_scan_ < scan_interval)
+        return changed;
+    last_scan_ = now;
+
+    std::error_code error;
+    for (auto const & entry : std::filesystem::directory_iterator(directory_, error))
+    {
+        auto name = entry.path().filename().string();
+        auto time = entry.last_write_time(error);
+        auto it = modified_.find(name);
+        if (it == modified_.end() || it->second != time)
+        {
+            modified_[name] = time;
+            add(name);
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+// Reports files of a directory that were written since the previous poll. Uses inotify on
+// Linux and compares modification times elsewhere; polling never blocks.
+class ShaderWatcher
+{
+public:
+    explicit ShaderWatcher(std::string directory);
+    ~ShaderWatcher();
+
+    ShaderWatcher(const ShaderWatcher &) = delete;
+    ShaderWatcher & operator=(const ShaderWatcher &) = delete;
+
+    // File names relative to the directory, each reported once per poll.
+    std::vector<std::string> poll();
+
+private:
+    std::string directory_;
+#ifdef __linux__
+    int fd_ = -1;
+#endif
+    std::map<std::string, std::filesystem::file_time_type> modified_;
+    std::chrono::steady_clock::time_point last_scan_;
+};
@@ -0,0 +1,52 @@
+#version 330 core
+
+#include "uniforms.glsl"
+#include "color.glsl"
+
+// One level of the bloom chain: color_tex filtered to half its size with the 13 taps of
+// Jimenez's downsample (four overlapping 4x4 boxes and a centred one), which doesn't flicker as
+// the image moves by less than a texel. With BLOOM_PREFILTER it reads the scene in the
+// render_size corner of color_tex, decodes it to linear light and keeps what is brighter than
+// bloom_threshold.
+uniform sampler2D color_tex;
+
+layout (location = 0) out vec4 out_color;
+
+vec3 color_at(vec2 uv) {
+#ifdef BLOOM_PREFILTER
+    // The scene only fills the render_size corner, lookups stay inside it.
+    vec2 uv_max = (render_size - 0.5) / vec2(textureSize(color_tex, 0));
+    return decode_display(texture(color_tex, min(uv, uv_max)).rgb);
+#else
+    return texture(color_tex, uv).rgb;
+#endif
+}
+
+// Soft knee around the threshold, so highlights fade in rather than pop.
+vec3 bright_part(vec3 color) {
+    float brightness = max(color.r, max(color.g, color.b));
+    float knee = bloom_threshold * 0.5;
+    float soft = clamp(brightness - bloom_threshold + knee, 0.0, 2.0 * knee);
+    soft = soft * soft / (4.0 * knee + 1e-4);
+    return color * max(soft, brightness - bloom_threshold) / max(brightness, 1e-4);
+}
+
+void main()
+{
+    vec2 texel_size = 1.0 / vec2(textureSize(color_tex, 0));
+    // The centre of this pixel is the corner shared by four source texels.
+    vec2 uv = gl_FragCoord.xy * 2.0 * texel_size;
+
+    vec3 outer = color_at(uv + texel_size * vec2(-2.0, -2.0)) + color_at(uv + texel_size * vec2(2.0, -2.0))
+        + color_at(uv + texel_size * vec2(-2.0, 2.0)) + color_at(uv + texel_size * vec2(2.0, 2.0));
+    vec3 edges = color_at(uv + texel_size * vec2(0.0, -2.0)) + color_at(uv + texel_size * vec2(-2.0, 0.0))
+        + color_at(uv + texel_size * vec2(2.0, 0.0)) + color_at(uv + texel_size * vec2(0.0, 2.0));
+    vec3 inner = color_at(uv + texel_size * vec2(-1.0, -1.0)) + color_at(uv + texel_size * vec2(1.0, -1.0))
+        + color_at(uv + texel_size * vec2(-1.0, 1.0)) + color_at(uv + texel_size * vec2(1.0, 1.0));
+    vec3 color = color_at(uv) * 0.125 + outer * 0.03125 + edges * 0.0625 + inner * 0.125;
+
+#ifdef BLOOM_PREFILTER
+    color = bright_part(color);
+#endif
+    out_color = vec4(color, 1.0);
+}
@@ -0,0 +1,22 @@
+#version 330 core
+
+// One level on the way back up the bloom chain: this level of the downsample chain plus the
+// next smaller level, which already holds everything below it, upsampled with a 3x3 tent.
+uniform sampler2D level_tex;
+uniform sampler2D bloom_tex;
+
+layout (location = 0) out vec4 out_color;
+
+void main()
+{
+    vec2 uv = gl_FragCoord.xy / vec2(textureSize(level_tex, 0));
+    vec2 texel_size = 1.0 / vec2(textureSize(bloom_tex, 0));
+
+    vec3 bloom = texture(bloom_tex, uv).rgb * 4.0;
+    bloom += (texture(bloom_tex, uv + vec2(-texel_size.x, 0.0)).rgb + texture(bloom_tex, uv + vec2(texel_size.x, 0.0)).rgb
+        + texture(bloom_tex, uv + vec2(0.0, -texel_size.y)).rgb + texture(bloom_tex, uv + vec2(0.0, texel_size.y)).rgb) * 2.0;
+    bloom += texture(bloom_tex, uv - texel_size).rgb + texture(bloom_tex, uv + texel_size).rgb
+        + texture(bloom_tex, uv + vec2(-texel_size.x, texel_size.y)).rgb + texture(bloom_tex, uv + vec2(texel_size.x, -texel_size.y)).rgb;
+
+    out_color = vec4(texelFetch(level_tex, ivec2(gl_FragCoord.xy), 0).rgb + bloom / 16.0, 1.0);
+}
@@ -0,0 +1,19 @@
+#version 330 core
+
+#include "uniforms.glsl"
+
+in vec3 normal;
+
+#include "fresnel.glsl"
+
+layout (location = 0) out vec4 out_color;
+
+void main()
+{
+    float n1 = 1.0;
+    float n2 = 1.333;
+    float cosine = dot(normalize(normal), sun_direction);
+    float coef = fresnel(cosine, n1, n2);
+    vec3 color = (1 - coef) * sun_light;
+    out_color = vec4(sun_light, 1.0 - coef);
+}
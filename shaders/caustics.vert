@@ -0,0 +1,21 @@
+#version 330 core
+
+#include "uniforms.glsl"
+
+layout (location = 0) in vec2 in_position;
+
+out vec3 normal;
+
+#include "waves.glsl"
+#include "refraction.glsl"
+
+void main()
+{
+    vec2 grid_position = in_position * water_scale + water_offset;
+    vec3 position = vec3(grid_position.x, get_height(grid_position, time), grid_position.y);
+    position = (model * vec4(position, 1.0)).xyz;
+    normal = normalize(vec3(-dhdx(grid_position, time), 1.0, -dhdy(grid_position, time)));
+    vec2 texcoord = refract_to_floor(sun_direction, 1.0, 1.33, normal, position).xz;
+    texcoord /= vec2(floor_width, floor_height);
+    gl_Position = vec4(texcoord * 2.0 - 1.0, 0.0, 1.0);
+}
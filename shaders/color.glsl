@@ -0,0 +1,17 @@
+// The scene shaders write display values, as they did into the 8-bit window before there was
+// tonemapping. Post-processing decodes them to linear light with a plain 2.2 gamma, which
+// keeps the image close to what it was at an exposure of 1.
+
+const float display_gamma = 2.2;
+
+vec3 decode_display(vec3 color) {
+    return pow(max(color, vec3(0.0)), vec3(display_gamma));
+}
+
+vec3 encode_display(vec3 color) {
+    return pow(max(color, vec3(0.0)), vec3(1.0 / display_gamma));
+}
+
+float luminance(vec3 color) {
+    return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
@@ -0,0 +1,6 @@
+#version 330 core
+
+// Fragment stage of depth-only passes; color writes are masked off.
+void main()
+{
+}
@@ -0,0 +1,28 @@
+#version 330 core
+
+#if TEMPORAL_AA
+#include "uniforms.glsl"
+#include "motion.glsl"
+#endif
+
+uniform samplerCube tex;
+
+in vec3 position;
+
+layout (location = 0) out vec4 out_color;
+
+#if TEMPORAL_AA
+in vec4 current_clip;
+in vec4 previous_clip;
+
+layout (location = 1) out vec2 out_motion;
+#endif
+
+void main()
+{
+    vec3 color = texture(tex, position).rgb;
+    out_color = vec4(color, 1.0);
+#if TEMPORAL_AA
+    out_motion = screen_motion(current_clip, previous_clip);
+#endif
+}
@@ -0,0 +1,24 @@
+#version 330 core
+
+layout (location = 0) in vec3 in_position;
+
+#include "uniforms.glsl"
+
+out vec3 position;
+#if TEMPORAL_AA
+#include "motion.glsl"
+
+out vec4 current_clip;
+out vec4 previous_clip;
+#endif
+
+void main()
+{
+    gl_Position = env_view * model * vec4(in_position, 1.0);
+    gl_Position.z = gl_Position.w;
+    position = in_position;
+#if TEMPORAL_AA
+    current_clip = unjittered(gl_Position);
+    previous_clip = previous_env_view * model * vec4(in_position, 1.0);
+#endif
+}
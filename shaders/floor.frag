@@ -0,0 +1,58 @@
+#version 330 core
+
+#include "uniforms.glsl"
+#include "ibl.glsl"
+
+uniform sampler2D tex;
+uniform sampler2D caustics_tex;
+
+in vec3 position;
+in vec3 normal;
+in vec2 texcoord;
+
+layout (location = 0) out vec4 out_color;
+#if TEMPORAL_AA
+#include "motion.glsl"
+
+in vec4 current_clip;
+in vec4 previous_clip;
+
+layout (location = 1) out vec2 out_motion;
+#endif
+
+float diffuse(vec3 direction) {
+    return max(0.0, dot(normal, direction));
+}
+
+vec3 reflect(vec3 direction) {
+    float cosine = dot(normal, direction);
+    return 2.0 * normal * cosine - direction;
+}
+
+float specular(vec3 direction) {
+    vec3 view_direction = normalize(camera_position - position);
+    vec3 reflected = reflect(direction);
+    float power = 1 / (roughness * roughness) - 1;
+    return glossiness * pow(max(0.0, dot(reflected, view_direction)), power);
+}
+
+void main()
+{
+    vec3 albedo = texture(tex, texcoord).xyz;
+#if CAUSTICS
+    vec2 caustics_texcoord = position.xz / vec2(floor_width, floor_height);
+    vec4 caustics_data = texture(caustics_tex, caustics_texcoord);
+    albedo += caustics_data.w * caustics_data.xyz;
+#endif
+    // albedo = caustics_data.xyz;
+    vec3 color = albedo * ambient_light * sh_irradiance(normal);
+    float sun_impact = diffuse(sun_direction);
+#if QUALITY >= 1
+    sun_impact += specular(sun_direction);
+#endif
+    color += albedo * sun_impact * sun_light;
+    out_color = vec4(color, 1.0);
+#if TEMPORAL_AA
+    out_motion = screen_motion(current_clip, previous_clip);
+#endif
+}
@@ -0,0 +1,29 @@
+#version 330 core
+
+#include "uniforms.glsl"
+
+layout (location = 0) in vec3 in_position;
+layout (location = 1) in vec3 in_normal;
+layout (location = 2) in vec2 in_texcoord;
+
+out vec3 position;
+out vec3 normal;
+out vec2 texcoord;
+#if TEMPORAL_AA
+#include "motion.glsl"
+
+out vec4 current_clip;
+out vec4 previous_clip;
+#endif
+
+void main()
+{
+    gl_Position = projection * view * model * vec4(in_position, 1.0);
+    position = (model * vec4(in_position, 1.0)).xyz;
+    texcoord = in_texcoord;
+    normal = in_normal;
+#if TEMPORAL_AA
+    current_clip = unjittered(gl_Position);
+    previous_clip = previous_view_projection * model * vec4(in_position, 1.0);
+#endif
+}
@@ -0,0 +1,7 @@
+// Schlick's approximation of the reflected fraction of light between media n1 and n2.
+
+float fresnel(float cosine, float n1, float n2) {
+    float coef = (n1 - n2) / (n1 + n2);
+    coef = coef * coef;
+    return coef + (1 - coef) * pow(1 - cosine, 5);
+}
@@ -0,0 +1,8 @@
+#version 330 core
+
+// One triangle covering the viewport, drawn without vertex attributes. The fragment stage
+// addresses its inputs with gl_FragCoord.
+void main()
+{
+    gl_Position = vec4(vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,134 @@
+#version 330 core
+
+#include "uniforms.glsl"
+
+// Fast approximate anti-aliasing (after Lottes' FXAA 3.11 quality preset) of the image drawn
+// into the render_size corner of color_tex. Edges are found from luma contrast, followed along
+// their direction to both ends, and the pixel is blended across the edge by how close it is to
+// the nearer end.
+uniform sampler2D color_tex;
+
+layout (location = 0) out vec4 out_color;
+
+// Contrast below the larger of these, relative to the brightest neighbour, is not an edge.
+const float edge_threshold = 1.0 / 8.0;
+const float edge_threshold_min = 1.0 / 16.0;
+// How much single-pixel features are softened.
+const float subpixel_quality = 0.75;
+// Steps along the edge in each direction, longer once the edge is long.
+const int search_steps = 12;
+const float search_step_scale[12] = float[](1.0, 1.0, 1.0, 1.0, 1.0, 1.5, 2.0, 2.0, 2.0, 2.0, 4.0, 8.0);
+
+vec3 color_at(vec2 uv) {
+    // The texture is larger than the image with dynamic resolution, lookups stay inside it.
+    vec2 uv_max = (render_size - 0.5) / vec2(textureSize(color_tex, 0));
+    return texture(color_tex, min(uv, uv_max)).rgb;
+}
+
+float luma(vec3 color) {
+    return dot(color, vec3(0.299, 0.587, 0.114));
+}
+
+float luma_at(vec2 uv) {
+    return luma(color_at(uv));
+}
+
+void main()
+{
+    vec2 texel_size = 1.0 / vec2(textureSize(color_tex, 0));
+    vec2 uv = gl_FragCoord.xy * texel_size;
+
+    vec3 center_color = color_at(uv);
+    float center = luma(center_color);
+    float down = luma_at(uv + vec2(0.0, -texel_size.y));
+    float up = luma_at(uv + vec2(0.0, texel_size.y));
+    float left = luma_at(uv + vec2(-texel_size.x, 0.0));
+    float right = luma_at(uv + vec2(texel_size.x, 0.0));
+    float luma_min = min(center, min(min(down, up), min(left, right)));
+    float luma_max = max(center, max(max(down, up), max(left, right)));
+    float range = luma_max - luma_min;
+    if (range < max(edge_threshold_min, luma_max * edge_threshold)) {
+        out_color = vec4(center_color, 1.0);
+        return;
+    }
+
+    float down_left = luma_at(uv - texel_size);
+    float up_right = luma_at(uv + texel_size);
+    float up_left = luma_at(uv + vec2(-texel_size.x, texel_size.y));
+    float down_right = luma_at(uv + vec2(texel_size.x, -texel_size.y));
+    float down_up = down + up;
+    float left_right = left + right;
+    float left_corners = down_left + up_left;
+    float down_corners = down_left + down_right;
+    float right_corners = down_right + up_right;
+    float up_corners = up_right + up_left;
+
+    float edge_horizontal = abs(-2.0 * left + left_corners) + 2.0 * abs(-2.0 * center + down_up) + abs(-2.0 * right + right_corners);
+    float edge_vertical = abs(-2.0 * up + up_corners) + 2.0 * abs(-2.0 * center + left_right) + abs(-2.0 * down + down_corners);
+    bool horizontal = edge_horizontal >= edge_vertical;
+
+    // The edge runs between this pixel and the neighbour across it with the larger gradient.
+    float luma1 = horizontal ? down : left;
+    float luma2 = horizontal ? up : right;
+    float gradient1 = luma1 - center;
+    float gradient2 = luma2 - center;
+    bool steepest1 = abs(gradient1) >= abs(gradient2);
+    float gradient_scaled = 0.25 * max(abs(gradient1), abs(gradient2));
+    float step_length = horizontal ? texel_size.y : texel_size.x;
+    float local_average;
+    if (steepest1) {
+        step_length = -step_length;
+        local_average = 0.5 * (luma1 + center);
+    } else {
+        local_average = 0.5 * (luma2 + center);
+    }
+
+    // Walk along the edge, half a pixel across it, until the luma leaves the edge's average.
+    vec2 edge_uv = uv;
+    if (horizontal)
+        edge_uv.y += step_length * 0.5;
+    else
+        edge_uv.x += step_length * 0.5;
+    vec2 offset = horizontal ? vec2(texel_size.x, 0.0) : vec2(0.0, texel_size.y);
+    vec2 uv1 = edge_uv - offset;
+    vec2 uv2 = edge_uv + offset;
+    float end1 = 0.0;
+    float end2 = 0.0;
+    bool reached1 = false;
+    bool reached2 = false;
+    for (int i = 0; i < search_steps && !(reached1 && reached2); ++i) {
+        if (!reached1) {
+            end1 = luma_at(uv1) - local_average;
+            reached1 = abs(end1) >= gradient_scaled;
+            if (!reached1)
+                uv1 -= offset * search_step_scale[i];
+        }
+        if (!reached2) {
+            end2 = luma_at(uv2) - local_average;
+            reached2 = abs(end2) >= gradient_scaled;
+            if (!reached2)
+                uv2 += offset * search_step_scale[i];
+        }
+    }
+
+    float distance1 = horizontal ? uv.x - uv1.x : uv.y - uv1.y;
+    float distance2 = horizontal ? uv2.x - uv.x : uv2.y - uv.y;
+    bool direction1 = distance1 < distance2;
+    float distance_final = min(distance1, distance2);
+    float pixel_offset = -distance_final / (distance1 + distance2) + 0.5;
+    // Only blend when the nearer end goes the other way from this pixel, past the edge.
+    bool center_smaller = center < local_average;
+    bool correct_variation = ((direction1 ? end1 : end2) < 0.0) != center_smaller;
+    float final_offset = correct_variation ? pixel_offset : 0.0;
+
+    float luma_average = (1.0 / 12.0) * (2.0 * (down_up + left_right) + left_corners + right_corners);
+    float subpixel = clamp(abs(luma_average - center) / range, 0.0, 1.0);
+    subpixel = (-2.0 * subpixel + 3.0) * subpixel * subpixel;
+    final_offset = max(final_offset, subpixel * subpixel * subpixel_quality);
+
+    if (horizontal)
+        uv.y += final_offset * step_length;
+    else
+        uv.x += final_offset * step_length;
+    out_color = vec4(color_at(uv), 1.0);
+}
@@ -0,0 +1,35 @@
+// Lighting from the environment cubemap, baked at load time by ibl.cpp and mirrored by
+// EnvironmentUniforms in uniform_buffer.hpp.
+
+layout (std140) uniform Environment {
+    // Irradiance already convolved with the cosine lobe and divided by pi, rgb in xyz.
+    vec4 irradiance_sh[9];
+    // Last level of specular_tex, which holds roughness 1.
+    float specular_max_lod;
+};
+
+uniform samplerCube specular_tex;
+
+// Diffuse light arriving at a surface with this normal, as a factor of the albedo.
+vec3 sh_irradiance(vec3 n) {
+    vec3 result = irradiance_sh[0].xyz * 0.282095;
+    result += irradiance_sh[1].xyz * (0.488603 * n.y);
+    result += irradiance_sh[2].xyz * (0.488603 * n.z);
+    result += irradiance_sh[3].xyz * (0.488603 * n.x);
+    result += irradiance_sh[4].xyz * (1.092548 * n.x * n.y);
+    result += irradiance_sh[5].xyz * (1.092548 * n.y * n.z);
+    result += irradiance_sh[6].xyz * (0.315392 * (3.0 * n.z * n.z - 1.0));
+    result += irradiance_sh[7].xyz * (1.092548 * n.x * n.z);
+    result += irradiance_sh[8].xyz * (0.546274 * (n.x * n.x - n.y * n.y));
+    return max(result, vec3(0.0));
+}
+
+// Environment reflected in direction by a surface of the given roughness. Level 0 of
+// specular_tex is far smaller than the sky, so surfaces smoother than level 1 reflect the sky
+// itself, filtered by its mipmaps with the screen derivatives of direction.
+vec3 specular_radiance(samplerCube sky, vec3 direction, vec3 direction_dx, vec3 direction_dy, float roughness) {
+    float lod = roughness * specular_max_lod;
+    if (lod < 1.0)
+        return textureGrad(sky, direction, direction_dx, direction_dy).rgb;
+    return textureLod(specular_tex, direction, lod).rgb;
+}
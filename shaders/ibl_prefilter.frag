@@ -0,0 +1,81 @@
+#version 330 core
+
+// Convolves the environment with the GGX lobe of one roughness for one face of one level of
+// the specular cubemap. Like the split-sum approximation the view direction is assumed to be
+// the normal, so the result only depends on the reflected direction.
+
+uniform samplerCube tex;
+uniform int face;
+uniform float roughness;
+// Texels per face of level 0 of tex.
+uniform float source_size;
+
+in vec2 face_position;
+
+layout (location = 0) out vec4 out_color;
+
+const float PI = 3.14159265;
+const int sample_count = 64;
+
+// Texel coordinates in [-1, 1] to the direction GL samples there, see the cube map face
+// selection table of the specification.
+vec3 face_direction(vec2 p) {
+    if (face == 0) return vec3(1.0, -p.y, -p.x);
+    if (face == 1) return vec3(-1.0, -p.y, p.x);
+    if (face == 2) return vec3(p.x, 1.0, p.y);
+    if (face == 3) return vec3(p.x, -1.0, -p.y);
+    if (face == 4) return vec3(p.x, -p.y, 1.0);
+    return vec3(-p.x, -p.y, -1.0);
+}
+
+vec2 hammersley(int i) {
+    uint bits = uint(i);
+    bits = (bits << 16u) | (bits >> 16u);
+    bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+    bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+    bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+    bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+    return vec2(float(i) / float(sample_count), float(bits) * 2.3283064365386963e-10);
+}
+
+void main()
+{
+    vec3 normal = normalize(face_direction(face_position));
+    if (roughness == 0.0) {
+        out_color = vec4(textureLod(tex, normal, 0.0).rgb, 1.0);
+        return;
+    }
+
+    vec3 up = abs(normal.y) < 0.999 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+    vec3 tangent = normalize(cross(up, normal));
+    vec3 bitangent = cross(normal, tangent);
+
+    float alpha = roughness * roughness;
+    float alpha2 = alpha * alpha;
+    float texel_solid_angle = 4.0 * PI / (6.0 * source_size * source_size);
+
+    vec3 sum = vec3(0.0);
+    float weight = 0.0;
+    for (int i = 0; i < sample_count; ++i) {
+        vec2 xi = hammersley(i);
+        float phi = 2.0 * PI * xi.x;
+        float cos_theta = sqrt((1.0 - xi.y) / (1.0 + (alpha2 - 1.0) * xi.y));
+        float sin_theta = sqrt(1.0 - cos_theta * cos_theta);
+        vec3 half_vector = tangent * (sin_theta * cos(phi)) + bitangent * (sin_theta * sin(phi)) + normal * cos_theta;
+        vec3 light = 2.0 * dot(normal, half_vector) * half_vector - normal;
+        float n_dot_l = dot(normal, light);
+        if (n_dot_l <= 0.0)
+            continue;
+
+        // With the view along the normal the density of light is D / 4. Each sample reads the
+        // level whose texels cover the solid angle it stands for, which removes the aliasing
+        // of a few samples over a detailed source.
+        float d = cos_theta * cos_theta * (alpha2 - 1.0) + 1.0;
+        float pdf = alpha2 / (4.0 * PI * d * d);
+        float sample_solid_angle = 1.0 / (float(sample_count) * pdf);
+        float lod = max(0.5 * log2(sample_solid_angle / texel_solid_angle) + 1.0, 0.0);
+        sum += textureLod(tex, light, lod).rgb * n_dot_l;
+        weight += n_dot_l;
+    }
+    out_color = vec4(sum / weight, 1.0);
+}
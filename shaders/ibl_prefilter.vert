@@ -0,0 +1,10 @@
+#version 330 core
+
+// One triangle covering the viewport, drawn without vertex attributes.
+out vec2 face_position;
+
+void main()
+{
+    face_position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0;
+    gl_Position = vec4(face_position, 0.0, 1.0);
+}
@@ -0,0 +1,12 @@
+// Screen motion for temporal anti-aliasing. Vertex stages pass their clip position without the
+// jitter and the clip position of the same point in the previous frame, fragment stages write
+// the difference to the motion target.
+
+vec4 unjittered(vec4 clip) {
+    return vec4(clip.xy - jitter * clip.w, clip.zw);
+}
+
+// Motion since the previous frame in texture coordinates of the viewport.
+vec2 screen_motion(vec4 current_clip, vec4 previous_clip) {
+    return (current_clip.xy / current_clip.w - previous_clip.xy / previous_clip.w) * 0.5;
+}
@@ -0,0 +1,16 @@
+// Point of the pool floor (y = 0) seen through the water surface at position along direction.
+
+vec3 refract_to_floor(vec3 direction, float n1, float n2, vec3 normal, vec3 position) {
+    float cosine = dot(normalize(normal), direction);
+    float sine = sqrt(1 - cosine * cosine);
+    float refract_sine = n1 * sine / n2;
+    float refract_cosine = sqrt(1 - refract_sine * refract_sine);
+    float h = position.y;
+    float straight_floor_x = -direction.x * h / direction.y + position.x;
+    float straight_floor_z = -direction.z * h / direction.y + position.z;
+    vec3 projection_position = vec3(position.x, 0.0, position.y);
+    vec3 straight_projection = vec3(straight_floor_x, 0.0, straight_floor_z) - projection_position;
+    vec3 refracted_projection = straight_projection * n1 / n2 * cosine / refract_cosine;
+    vec3 refracted_position = projection_position + refracted_projection;
+    return refracted_position;
+}
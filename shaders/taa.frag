@@ -0,0 +1,55 @@
+#version 330 core
+
+#include "uniforms.glsl"
+#include "color.glsl"
+
+// This frame's jittered scene with its motion and depth, and the image resolved last frame.
+uniform sampler2D color_tex;
+uniform sampler2D motion_tex;
+uniform sampler2D depth_tex;
+uniform sampler2D history_tex;
+
+layout (location = 0) out vec4 out_color;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    ivec2 last_pixel = ivec2(render_size) - 1;
+    vec3 current = texelFetch(color_tex, pixel, 0).rgb;
+
+    // The history is clamped to the colors around the pixel, so surfaces that moved away or
+    // were uncovered don't linger. Motion is taken from the nearest surface around the pixel,
+    // which keeps edges of moving geometry from trailing.
+    vec3 neighbourhood_min = current;
+    vec3 neighbourhood_max = current;
+    ivec2 nearest = pixel;
+    float nearest_depth = 1.0;
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            ivec2 neighbour = clamp(pixel + ivec2(x, y), ivec2(0), last_pixel);
+            vec3 color = texelFetch(color_tex, neighbour, 0).rgb;
+            neighbourhood_min = min(neighbourhood_min, color);
+            neighbourhood_max = max(neighbourhood_max, color);
+            float depth = texelFetch(depth_tex, neighbour, 0).r;
+            if (depth < nearest_depth) {
+                nearest_depth = depth;
+                nearest = neighbour;
+            }
+        }
+    }
+
+    // The history may have been resolved at another render size, it fills the corner of its
+    // texture that history_size gives.
+    vec2 previous_uv = gl_FragCoord.xy / render_size - texelFetch(motion_tex, nearest, 0).xy;
+    if (any(lessThan(previous_uv, vec2(0.0))) || any(greaterThan(previous_uv, vec2(1.0)))) {
+        out_color = vec4(current, 1.0);
+        return;
+    }
+    vec3 history = texture(history_tex, previous_uv * history_size / vec2(textureSize(history_tex, 0))).rgb;
+    history = clamp(history, neighbourhood_min, neighbourhood_max);
+    // The scene is HDR: weighted by inverse luminance, a highlight only a few frames hit doesn't
+    // dominate the average and flicker.
+    float current_share = (1.0 - history_weight) / (1.0 + luminance(current));
+    float history_share = history_weight / (1.0 + luminance(history));
+    out_color = vec4((current * current_share + history * history_share) / (current_share + history_share), 1.0);
+}
@@ -0,0 +1,27 @@
+#version 330 core
+
+#include "uniforms.glsl"
+#include "color.glsl"
+
+// Maps the HDR scene in the render_size corner of color_tex to the display: decoded to linear
+// light, the bloom added, scaled by the exposure and compressed with a filmic curve whose
+// shoulder rolls highlights off to white instead of clipping them.
+uniform sampler2D color_tex;
+uniform sampler2D bloom_tex;
+
+layout (location = 0) out vec4 out_color;
+
+// Narkowicz's fit of the ACES reference rendering and output transforms.
+vec3 filmic(vec3 color) {
+    return clamp(color * (2.51 * color + 0.03) / (color * (2.43 * color + 0.59) + 0.14), 0.0, 1.0);
+}
+
+void main()
+{
+    vec3 color = decode_display(texelFetch(color_tex, ivec2(gl_FragCoord.xy), 0).rgb);
+#if BLOOM
+    // The first bloom level covers the image at half its size.
+    color += texture(bloom_tex, gl_FragCoord.xy / render_size).rgb * bloom_strength;
+#endif
+    out_color = vec4(encode_display(filmic(color * exposure)), 1.0);
+}
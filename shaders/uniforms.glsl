@@ -0,0 +1,41 @@
+// Per-frame and per-draw data shared by all programs, mirrored by FrameUniforms and
+// MaterialUniforms in uniform_buffer.hpp.
+
+layout (std140) uniform Frame {
+    mat4 model;
+    mat4 view;
+    mat4 projection;
+    mat4 env_view;
+    vec3 camera_position;
+    float time;
+    vec3 sun_direction;
+    float floor_width;
+    vec3 sun_light;
+    float floor_height;
+    vec3 ambient_light;
+    // Water grid vertices are in [0, 1], this maps them to the pool.
+    vec2 water_scale;
+    vec2 water_offset;
+    // Mirrored camera the planar reflection was last drawn with.
+    mat4 reflection_view_projection;
+    // Temporal anti-aliasing: the previous frame's camera and time, the sub-pixel offset of
+    // this frame's projection in normalized device coordinates, the size drawn this frame and
+    // that of the history, and how much of the history is kept (0 without one).
+    mat4 previous_view_projection;
+    mat4 previous_env_view;
+    vec2 jitter;
+    vec2 render_size;
+    vec2 history_size;
+    float previous_time;
+    float history_weight;
+    // Tonemapping of the linear scene: the exposure it is scaled by, and the brightness above
+    // which it blooms and how much of the bloom is added.
+    float exposure;
+    float bloom_threshold;
+    float bloom_strength;
+};
+
+layout (std140) uniform Material {
+    float glossiness;
+    float roughness;
+};
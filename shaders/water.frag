@@ -0,0 +1,131 @@
+#version 330 core
+
+#include "uniforms.glsl"
+#include "ibl.glsl"
+
+uniform samplerCube tex;
+uniform sampler2D floor_tex;
+uniform sampler2D caustics_tex;
+// Everything drawn before the water, at the size of the viewport.
+uniform sampler2D opaque_color_tex;
+uniform sampler2D opaque_depth_tex;
+#if PLANAR_REFLECTION
+// The scene above the water seen by the mirrored camera, possibly a few frames old.
+uniform sampler2D reflection_tex;
+#endif
+
+in vec3 position;
+in vec3 normal;
+
+layout (location = 0) out vec4 out_color;
+#if TEMPORAL_AA
+#include "motion.glsl"
+
+in vec4 current_clip;
+in vec4 previous_clip;
+
+layout (location = 1) out vec2 out_motion;
+#endif
+
+vec3 reflect(vec3 direction) {
+    float cosine = dot(normal, direction);
+    return 2.0 * normal * cosine - direction;
+}
+
+#include "fresnel.glsl"
+#include "refraction.glsl"
+
+vec3 get_floor(vec3 pos) {
+    vec3 albedo = texture(floor_tex, vec2(pos.x / 4.0, pos.z / 4.0)).xyz;
+#if CAUSTICS
+    vec4 caustics_data = texture(caustics_tex, pos.xz / vec2(floor_width, floor_height));
+    albedo += caustics_data.w * caustics_data.xyz;
+#endif
+    vec3 color = albedo * ambient_light * sh_irradiance(vec3(0.0, 1.0, 0.0));
+    color += albedo * max(0.0, sun_direction.y) * sun_light;
+    return color;
+}
+
+// The floor seen along the refracted ray where the opaque copy doesn't show it, which is most of
+// the water from the usual camera: the floor below it lies further down the screen. Rays that
+// miss the floor leave the pool and see the sky.
+vec3 get_floor_or_sky(vec3 view_direction, vec3 refracted, float n1, float n2) {
+    vec3 floor_position = refract_to_floor(view_direction, n1, n2, normal, position);
+    if (floor_position.x > 0 && floor_position.z > 0 && floor_position.x < floor_width && floor_position.z < floor_height)
+        return get_floor(floor_position);
+    return texture(tex, refracted).rgb;
+}
+
+// Texture coordinates of the opaque copy at a world position.
+vec2 screen_position(vec3 world_position) {
+    vec4 clip = projection * view * vec4(world_position, 1.0);
+    return clip.xy / clip.w * 0.5 + 0.5;
+}
+
+// Distance from the camera plane of what the opaque pass drew at uv, infinite for the sky.
+float opaque_distance(vec2 uv) {
+    float depth = texture(opaque_depth_tex, uv).r;
+    if (depth >= 1.0)
+        return 1e30;
+    return projection[3][2] / (depth * 2.0 - 1.0 + projection[2][2]);
+}
+
+// Refracted view of the opaque scene. The refracted ray is followed until it is as deep in
+// view space as what the opaque pass drew behind this pixel, and the point it reaches is looked
+// up in the copy. Lookups that land on something in front of the water fall back to the
+// unrefracted pixel, lookups that miss the opaque geometry to the floor below the surface.
+vec3 get_refract(vec3 view_direction, float n1, float n2) {
+    float water_distance = -(view * vec4(position, 1.0)).z;
+    vec2 uv = screen_position(position);
+    float opaque = opaque_distance(uv);
+    vec3 refracted = refract(-view_direction, normalize(normal), n1 / n2);
+    if (opaque > 1e29)
+        return get_floor_or_sky(view_direction, refracted, n1, n2);
+
+    vec3 camera_forward = -vec3(view[0][2], view[1][2], view[2][2]);
+    float ray_length = (opaque - water_distance) / max(dot(refracted, camera_forward), 0.1);
+    vec2 refracted_uv = clamp(screen_position(position + refracted * ray_length), vec2(0.0), vec2(1.0));
+    float refracted_distance = opaque_distance(refracted_uv);
+    if (refracted_distance < water_distance)
+        return texture(opaque_color_tex, uv).rgb;
+    if (refracted_distance > 1e29)
+        return get_floor_or_sky(view_direction, refracted, n1, n2);
+    return texture(opaque_color_tex, refracted_uv).rgb;
+}
+
+// How far the slope of the waves shifts the reflection lookup along the surface.
+const float reflection_distortion = 0.5;
+
+// The mirrored camera sees the reflection at a point of the surface where it projects the point
+// itself. Projecting with the matrix the reflection was drawn with reprojects it on frames
+// between updates; lookups that fall outside of it reflect the sky.
+vec3 get_reflect(vec3 view_direction) {
+    // Derivatives are undefined inside the branch below.
+    vec3 direction = reflect(view_direction);
+    vec3 direction_dx = dFdx(direction);
+    vec3 direction_dy = dFdy(direction);
+#if PLANAR_REFLECTION
+    vec3 surface = position + vec3(normal.x, 0.0, normal.z) * reflection_distortion;
+    vec4 clip = reflection_view_projection * vec4(surface, 1.0);
+    vec2 uv = clip.xy / clip.w * 0.5 + 0.5;
+    if (clip.w > 0.0 && all(greaterThanEqual(uv, vec2(0.0))) && all(lessThanEqual(uv, vec2(1.0))))
+        return texture(reflection_tex, uv).rgb;
+#endif
+    return specular_radiance(tex, direction, direction_dx, direction_dy, roughness);
+}
+
+void main()
+{
+    vec3 view_direction = normalize(camera_position - position);
+    float n1 = 1.0;
+    float n2 = 1.333;
+    float cosine = dot(normalize(normal), sun_direction);
+    float coef = fresnel(cosine, n1, n2);
+    vec3 reflect_color = coef * get_reflect(view_direction);
+    vec3 refract_color = (1 - coef) * get_refract(view_direction, n1, n2);
+    vec3 color = reflect_color + refract_color;
+    out_color = vec4(color, 1.0);
+#if TEMPORAL_AA
+    out_motion = screen_motion(current_clip, previous_clip);
+#endif
+}
@@ -0,0 +1,37 @@
+#version 330 core
+
+#include "uniforms.glsl"
+
+layout (location = 0) in vec2 in_position;
+
+out vec3 position;
+out vec3 normal;
+
+// The depth pre-pass and the GL_EQUAL color pass must produce bit-identical depth.
+invariant gl_Position;
+
+#include "waves.glsl"
+
+#if TEMPORAL_AA && !defined(DEPTH_ONLY)
+#include "motion.glsl"
+
+// The waves move the vertices as well as the camera does.
+out vec4 current_clip;
+out vec4 previous_clip;
+#endif
+
+void main()
+{
+    vec2 grid_position = in_position * water_scale + water_offset;
+    position = vec3(grid_position.x, get_height(grid_position, time), grid_position.y);
+    gl_Position = projection * view * model * vec4(position, 1.0);
+#ifndef DEPTH_ONLY
+    position = (model * vec4(position, 1.0)).xyz;
+    normal = normalize(vec3(-dhdx(grid_position, time), 1.0, -dhdy(grid_position, time)));
+#endif
+#if TEMPORAL_AA && !defined(DEPTH_ONLY)
+    vec3 previous_position = vec3(grid_position.x, get_height(grid_position, previous_time), grid_position.y);
+    current_clip = unjittered(gl_Position);
+    previous_clip = previous_view_projection * model * vec4(previous_position, 1.0);
+#endif
+}
@@ -0,0 +1,33 @@
+// Height field of the water surface at grid position p and its partial derivatives.
+// WAVE_COUNT (1-3) selects how many of the summed waves are evaluated.
+
+float get_height(vec2 p, float t) {
+    float base_height = 5;
+    float add = 0.5 * sin(p.x + t);
+#if WAVE_COUNT >= 2
+    add += 0.2 * cos(p.y + 3 * t);
+#endif
+#if WAVE_COUNT >= 3
+    add += 0.1 * sin(p.x + 2 * p.y + t);
+#endif
+    return base_height + add;
+}
+
+float dhdx(vec2 p, float t) {
+    float result = 0.5 * cos(p.x + t);
+#if WAVE_COUNT >= 3
+    result += 0.1 * cos(p.x + 2 * p.y + t);
+#endif
+    return result;
+}
+
+float dhdy(vec2 p, float t) {
+    float result = 0.0;
+#if WAVE_COUNT >= 2
+    result += -0.2 * sin(p.y + 3 * t);
+#endif
+#if WAVE_COUNT >= 3
+    result += 0.2 * cos(p.x + 2 * p.y + t);
+#endif
+    return result;
+}
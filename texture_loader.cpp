@@ -0,0 +1,482 @@
+#include "texture_loader.hpp"
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::string & path)
+{
+#ifdef _WIN32
+    file_ = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file_ == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Can't open " + path);
+    LARGE_INTEGER size;
+    GetFileSizeEx(file_, &size);
+    size_ = static_cast<std::size_t>(size.QuadPart);
+    mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_)
+    {
+        CloseHandle(file_);
+        throw std::runtime_error("Can't map " + path);
+    }
+    data_ = static_cast<const unsigned char *>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (!data_)
+    {
+        CloseHandle(mapping_);
+        CloseHandle(file_);
+        throw std::runtime_error("Can't map " + path);
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Can't open " + path);
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        close(fd);
+        throw std::runtime_error("Can't stat " + path);
+    }
+    size_ = static_cast<std::size_t>(info.st_size);
+    void * data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        throw std::runtime_error("Can't map " + path);
+    // The whole file is consumed front to back during upload, so let the kernel read ahead.
+    madvise(data, size_, MADV_SEQUENTIAL);
+    madvise(data, size_, MADV_WILLNEED);
+    data_ = static_cast<const unsigned char *>(data);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+    UnmapViewOfFile(data_);
+    CloseHandle(mapping_);
+    CloseHandle(file_);
+#else
+    munmap(const_cast<unsigned char *>(data_), size_);
+#endif
+}
+
+namespace
+{
+
+struct FormatInfo {
+    GLenum internal_format;
+    GLenum format;
+    GLenum type;
+    bool compressed;
+    int block_bytes; // bytes per 4x4 block for compressed formats, bytes per pixel otherwise
+};
+
+std::uint32_t read_u32(const unsigned char * data)
+{
+    std::uint32_t result;
+    std::memcpy(&result, data, sizeof(result));
+    return result;
+}
+
+std::uint64_t read_u64(const unsigned char * data)
+{
+    std::uint64_t result;
+    std::memcpy(&result, data, sizeof(result));
+    return result;
+}
+
+std::size_t level_size(const FormatInfo & info, int width, int height)
+{
+    if (info.compressed)
+        return std::size_t(std::max(1, (width + 3) / 4)) * std::max(1, (height + 3) / 4) * info.block_bytes;
+    return std::size_t(width) * height * info.block_bytes;
+}
+
+bool vk_format_info(std::uint32_t vk_format, FormatInfo & info)
+{
+    switch (vk_format)
+    {
+    case 23: info = {GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE, false, 3}; return true;
+    case 29: info = {GL_SRGB8, GL_RGB, GL_UNSIGNED_BYTE, false, 3}; return true;
+    case 37: info = {GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, false, 4}; return true;
+    case 43: info = {GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE, false, 4}; return true;
+    case 44: info = {GL_RGBA8, GL_BGRA, GL_UNSIGNED_BYTE, false, 4}; return true;
+    case 97: info = {GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, false, 8}; return true;
+    case 131: info = {GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 0, 0, true, 8}; return true;
+    case 132: info = {GL_COMPRESSED_SRGB_S3TC_DXT1_EXT, 0, 0, true, 8}; return true;
+    case 133: info = {GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 0, 0, true, 8}; return true;
+    case 134: info = {GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 0, 0, true, 8}; return true;
+    case 135: info = {GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 0, 0, true, 16}; return true;
+    case 136: info = {GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, 0, 0, true, 16}; return true;
+    case 137: info = {GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 0, 0, true, 16}; return true;
+    case 138: info = {GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 0, 0, true, 16}; return true;
+    case 145: info = {GL_COMPRESSED_RGBA_BPTC_UNORM, 0, 0, true, 16}; return true;
+    case 146: info = {GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 0, 0, true, 16}; return true;
+    }
+    return false;
+}
+
+bool dxgi_format_info(std::uint32_t dxgi_format, FormatInfo & info)
+{
+    switch (dxgi_format)
+    {
+    case 10: info = {GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, false, 8}; return true;
+    case 28: info = {GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, false, 4}; return true;
+    case 29: info = {GL_SRGB8_ALPHA8, GL_RGBA, GL_UNSIGNED_BYTE, false, 4}; return true;
+    case 87: info = {GL_RGBA8, GL_BGRA, GL_UNSIGNED_BYTE, false, 4}; return true;
+    case 71: info = {GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 0, 0, true, 8}; return true;
+    case 72: info = {GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT, 0, 0, true, 8}; return true;
+    case 74: info = {GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 0, 0, true, 16}; return true;
+    case 75: info = {GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT, 0, 0, true, 16}; return true;
+    case 77: info = {GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 0, 0, true, 16}; return true;
+    case 78: info = {GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT, 0, 0, true, 16}; return true;
+    case 98: info = {GL_COMPRESSED_RGBA_BPTC_UNORM, 0, 0, true, 16}; return true;
+    case 99: info = {GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM, 0, 0, true, 16}; return true;
+    }
+    return false;
+}
+
+const unsigned char ktx2_identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+// Parses one KTX2 image starting at data and returns its size in bytes.
+std::size_t parse_ktx2(const unsigned char * data, std::size_t size, ContainerTexture & texture)
+{
+    if (size < 80)
+        throw std::runtime_error("KTX2: truncated header");
+
+    std::uint32_t vk_format = read_u32(data + 12);
+    std::uint32_t pixel_width = read_u32(data + 20);
+    std::uint32_t pixel_height = read_u32(data + 24);
+    std::uint32_t pixel_depth = read_u32(data + 28);
+    std::uint32_t layer_count = read_u32(data + 32);
+    std::uint32_t face_count = read_u32(data + 36);
+    std::uint32_t level_count = std::max<std::uint32_t>(1, read_u32(data + 40));
+    std::uint32_t supercompression = read_u32(data + 44);
+
+    if (supercompression != 0)
+        throw std::runtime_error("KTX2: supercompressed images are not supported");
+    if (pixel_depth > 1 || layer_count > 1 || (face_count != 1 && face_count != 6))
+        throw std::runtime_error("KTX2: only 2D textures and cubemaps are supported");
+
+    FormatInfo info;
+    if (!vk_format_info(vk_format, info))
+        throw std::runtime_error("KTX2: unsupported vkFormat " + std::to_string(vk_format));
+
+    if (80 + std::size_t(level_count) * 24 > size)
+        throw std::runtime_error("KTX2: truncated level index");
+
+    std::size_t end = 80 + std::size_t(level_count) * 24;
+    end = std::max<std::size_t>(end, std::size_t(read_u32(data + 48)) + read_u32(data + 52));
+    end = std::max<std::size_t>(end, std::size_t(read_u32(data + 56)) + read_u32(data + 60));
+    end = std::max<std::size_t>(end, read_u64(data + 64) + read_u64(data + 72));
+
+    texture = {face_count == 6 ? GLenum(GL_TEXTURE_CUBE_MAP) : GLenum(GL_TEXTURE_2D), info.internal_format, info.format, info.type,
+        info.compressed, int(pixel_width), int(pixel_height), int(face_count), {}};
+
+    for (std::uint32_t level = 0; level < level_count; ++level)
+    {
+        const unsigned char * entry = data + 80 + level * 24;
+        std::uint64_t offset = read_u64(entry);
+        std::uint64_t length = read_u64(entry + 8);
+        if (offset + length > size)
+            throw std::runtime_error("KTX2: level data out of bounds");
+        end = std::max<std::size_t>(end, offset + length);
+
+        int width = std::max(1, int(pixel_width >> level));
+        int height = std::max(1, int(pixel_height >> level));
+        std::size_t face_size = level_size(info, width, height);
+        if (face_size * face_count > length)
+            throw std::runtime_error("KTX2: level " + std::to_string(level) + " is too small");
+
+        std::vector<TextureLevel> faces;
+        for (std::uint32_t face = 0; face < face_count; ++face)
+            faces.push_back({data + offset + face * face_size, face_size, width, height});
+        texture.levels.push_back(std::move(faces));
+    }
+
+    return end;
+}
+
+// Parses one DDS image starting at data and returns its size in bytes.
+std::size_t parse_dds(const unsigned char * data, std::size_t size, ContainerTexture & texture)
+{
+    if (size < 128 || read_u32(data + 4) != 124)
+        throw std::runtime_error("DDS: truncated header");
+
+    const unsigned char * header = data + 4;
+    std::uint32_t height = read_u32(header + 8);
+    std::uint32_t width = read_u32(header + 12);
+    std::uint32_t level_count = std::max<std::uint32_t>(1, read_u32(header + 24));
+    std::uint32_t pixel_flags = read_u32(header + 76);
+    std::uint32_t four_cc = read_u32(header + 80);
+    std::uint32_t caps2 = read_u32(header + 108);
+
+    const std::uint32_t ddpf_fourcc = 0x4;
+    const std::uint32_t ddpf_rgb = 0x40;
+    const std::uint32_t ddscaps2_cubemap = 0x200;
+    auto make_four_cc = [](const char (&code)[5]) {
+        return std::uint32_t(code[0]) | std::uint32_t(code[1]) << 8 | std::uint32_t(code[2]) << 16 | std::uint32_t(code[3]) << 24;
+    };
+
+    std::size_t offset = 128;
+    bool cubemap = (caps2 & ddscaps2_cubemap) != 0;
+    FormatInfo info;
+
+    if ((pixel_flags & ddpf_fourcc) && four_cc == make_four_cc("DX10"))
+    {
+        if (size < 148)
+            throw std::runtime_error("DDS: truncated DX10 header");
+        std::uint32_t dxgi_format = read_u32(data + 128);
+        cubemap = cubemap || (read_u32(data + 136) & 0x4);
+        if (!dxgi_format_info(dxgi_format, info))
+            throw std::runtime_error("DDS: unsupported DXGI format " + std::to_string(dxgi_format));
+        offset = 148;
+    }
+    else if (pixel_flags & ddpf_fourcc)
+    {
+        if (four_cc == make_four_cc("DXT1"))
+            info = {GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 0, 0, true, 8};
+        else if (four_cc == make_four_cc("DXT3"))
+            info = {GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 0, 0, true, 16};
+        else if (four_cc == make_four_cc("DXT5"))
+            info = {GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 0, 0, true, 16};
+        else
+            throw std::runtime_error("DDS: unsupported FourCC");
+    }
+    else if ((pixel_flags & ddpf_rgb) && read_u32(header + 84) == 32)
+    {
+        bool bgra = read_u32(header + 88) == 0x00ff0000;
+        info = {GL_RGBA8, GLenum(bgra ? GL_BGRA : GL_RGBA), GL_UNSIGNED_BYTE, false, 4};
+    }
+    else
+    {
+        throw std::runtime_error("DDS: unsupported pixel format");
+    }
+
+    int face_count = cubemap ? 6 : 1;
+    texture = {cubemap ? GLenum(GL_TEXTURE_CUBE_MAP) : GLenum(GL_TEXTURE_2D), info.internal_format, info.format, info.type,
+        info.compressed, int(width), int(height), face_count, std::vector<std::vector<TextureLevel>>(level_count)};
+
+    // DDS stores every mip level of a face before moving on to the next face.
+    for (int face = 0; face < face_count; ++face)
+    {
+        for (std::uint32_t level = 0; level < level_count; ++level)
+        {
+            int level_width = std::max(1, int(width >> level));
+            int level_height = std::max(1, int(height >> level));
+            std::size_t face_size = level_size(info, level_width, level_height);
+            if (offset + face_size > size)
+                throw std::runtime_error("DDS: level data out of bounds");
+            texture.levels[level].push_back({data + offset, face_size, level_width, level_height});
+            offset += face_size;
+        }
+    }
+
+    return offset;
+}
+
+}
+
+std::vector<ContainerTexture> parse_texture_container(const MappedFile & file)
+{
+    std::vector<ContainerTexture> result;
+    std::size_t offset = 0;
+    while (offset < file.size())
+    {
+        const unsigned char * data = file.data() + offset;
+        std::size_t remaining = file.size() - offset;
+        ContainerTexture texture;
+        std::size_t size;
+        if (remaining >= sizeof(ktx2_identifier) && std::memcmp(data, ktx2_identifier, sizeof(ktx2_identifier)) == 0)
+            size = parse_ktx2(data, remaining, texture);
+        else if (remaining >= 4 && std::memcmp(data, "DDS ", 4) == 0)
+            size = parse_dds(data, remaining, texture);
+        else
+            throw std::runtime_error("Unknown texture container at offset " + std::to_string(offset));
+        result.push_back(std::move(texture));
+
+        // Images inside a pack are padded to 16 bytes so that every header stays aligned.
+        offset += (size + 15) & ~std::size_t(15);
+    }
+    return result;
+}
+
+DecodedImage decode_image_rgba8(const std::string & path)
+{
+    DecodedImage image;
+    int channels;
+    image.pixels = {stbi_load(path.c_str(), &image.width, &image.height, &channels, 4), stbi_image_free};
+    if (!image.pixels)
+        throw std::runtime_error("Can't load " + path + ": " + stbi_failure_reason());
+    return image;
+}
+
+int mip_level_count(int width, int height)
+{
+    int levels = 1;
+    while ((width | height) >> levels)
+        ++levels;
+    return levels;
+}
+
+void upload_container_texture(const ContainerTexture & texture, const TextureFiltering & filtering)
+{
+    // Compressed levels can't be generated by the driver, so those use whatever the container has.
+    int stored_levels = texture.levels.size();
+    int levels = 1;
+    if (filtering.mipmaps)
+        levels = texture.compressed ? stored_levels : std::max(stored_levels, mip_level_count(texture.width, texture.height));
+    stored_levels = std::min(stored_levels, levels);
+
+    bool immutable = GLEW_VERSION_4_2 || GLEW_ARB_texture_storage;
+    if (immutable)
+        glTexStorage2D(texture.target, levels, texture.internal_format, texture.width, texture.height);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int level = 0; level < stored_levels; ++level)
+    {
+        for (std::size_t face = 0; face < texture.levels[level].size(); ++face)
+        {
+            const TextureLevel & data = texture.levels[level][face];
+            GLenum target = texture.target == GL_TEXTURE_CUBE_MAP ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + face : texture.target;
+            if (immutable && texture.compressed)
+                glCompressedTexSubImage2D(target, level, 0, 0, data.width, data.height, texture.internal_format, data.size, data.data);
+            else if (immutable)
+                glTexSubImage2D(target, level, 0, 0, data.width, data.height, texture.format, texture.type, data.data);
+            else if (texture.compressed)
+                glCompressedTexImage2D(target, level, texture.internal_format, data.width, data.height, 0, data.size, data.data);
+            else
+                glTexImage2D(target, level, texture.internal_format, data.width, data.height, 0, texture.format, texture.type, data.data);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glTexParameteri(texture.target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    if (levels > stored_levels)
+        glGenerateMipmap(texture.target);
+
+    apply_texture_filtering(texture.target, filtering);
+}
+
+void apply_texture_filtering(GLenum target, const TextureFiltering & filtering)
+{
+    GLint max_level = 0;
+    glGetTexParameteriv(target, GL_TEXTURE_MAX_LEVEL, &max_level);
+    bool mipmapped = max_level > 0;
+
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameterf(target, GL_TEXTURE_LOD_BIAS, mipmapped ? filtering.lod_bias : 0.f);
+    if (mipmapped && (GLEW_EXT_texture_filter_anisotropic || GLEW_ARB_texture_filter_anisotropic))
+    {
+        GLfloat max_anisotropy = 1.f;
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &max_anisotropy);
+        glTexParameterf(target, GL_TEXTURE_MAX_ANISOTROPY_EXT, std::clamp(filtering.anisotropy, 1.f, max_anisotropy));
+    }
+}
+
+void upload_rgba8_texture(GLenum target, int width, int height, const std::vector<const unsigned char *> & faces,
+    const TextureFiltering & filtering)
+{
+    ContainerTexture texture = {target, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, false, width, height, int(faces.size()), {{}}};
+    for (const unsigned char * face : faces)
+        texture.levels[0].push_back({face, std::size_t(width) * height * 4, width, height});
+    upload_container_texture(texture, filtering);
+}
+
+void write_ktx2_rgba8(std::ostream & out, int width, int height, const std::vector<const unsigned char *> & faces)
+{
+    write_ktx2_rgba8_mipmapped(out, width, height, {faces});
+}
+
+void write_ktx2_rgba8_mipmapped(std::ostream & out, int width, int height, const std::vector<std::vector<const unsigned char *>> & levels)
+{
+    auto write_u32 = [&](std::uint32_t value) { out.write(reinterpret_cast<const char *>(&value), sizeof(value)); };
+    auto write_u64 = [&](std::uint64_t value) { out.write(reinterpret_cast<const char *>(&value), sizeof(value)); };
+
+    const std::uint32_t vk_format_r8g8b8a8_unorm = 37;
+    const std::uint32_t header_size = 80 + 24 * levels.size();
+    const std::size_t face_count = levels[0].size();
+
+    // Basic data format descriptor: linear RGBA, 8 bits per channel.
+    const std::uint32_t dfd_size = 4 + 24 + 4 * 16;
+    const std::string writer_key = "KTXwriter";
+    const std::string writer_value = "WaterPool";
+    const std::uint32_t kvd_entry_size = writer_key.size() + 1 + writer_value.size() + 1;
+    const std::uint32_t kvd_size = (4 + kvd_entry_size + 3) & ~3u;
+
+    // Level data is stored smallest level first; RGBA8 levels need no padding in between.
+    auto face_size = [&](std::size_t level) {
+        return std::uint64_t(std::max(1, width >> level)) * std::max(1, height >> level) * 4;
+    };
+    std::vector<std::uint64_t> level_offsets(levels.size());
+    std::uint64_t data_end = header_size + dfd_size + kvd_size;
+    for (std::size_t level = levels.size(); level-- > 0;) {
+        level_offsets[level] = data_end;
+        data_end += face_size(level) * face_count;
+    }
+
+    out.write(reinterpret_cast<const char *>(ktx2_identifier), sizeof(ktx2_identifier));
+    write_u32(vk_format_r8g8b8a8_unorm);
+    write_u32(1);
+    write_u32(width);
+    write_u32(height);
+    write_u32(0);
+    write_u32(0);
+    write_u32(face_count);
+    write_u32(levels.size());
+    write_u32(0);
+
+    write_u32(header_size);
+    write_u32(dfd_size);
+    write_u32(header_size + dfd_size);
+    write_u32(kvd_size);
+    write_u64(0);
+    write_u64(0);
+
+    for (std::size_t level = 0; level < levels.size(); ++level) {
+        write_u64(level_offsets[level]);
+        write_u64(face_size(level) * face_count);
+        write_u64(face_size(level) * face_count);
+    }
+
+    write_u32(dfd_size);
+    write_u32(0);
+    write_u32(2 | (24 + 4 * 16) << 16);
+    write_u32(1 | 1 << 8 | 1 << 16);
+    write_u32(0);
+    write_u32(4);
+    write_u32(0);
+    const std::uint32_t channels[4] = {0, 1, 2, 15};
+    for (int i = 0; i < 4; ++i)
+    {
+        write_u32(std::uint32_t(i * 8) | 7u << 16 | channels[i] << 24);
+        write_u32(0);
+        write_u32(0);
+        write_u32(255);
+    }
+
+    write_u32(kvd_entry_size);
+    out.write(writer_key.c_str(), writer_key.size() + 1);
+    out.write(writer_value.c_str(), writer_value.size() + 1);
+    for (std::uint32_t i = 4 + kvd_entry_size; i < kvd_size; ++i)
+        out.put(0);
+
+    for (std::size_t level = levels.size(); level-- > 0;) {
+        for (const unsigned char * face : levels[level])
+            out.write(reinterpret_cast<const char *>(face), face_size(level));
+    }
+
+    for (std::uint64_t i = data_end; i % 16 != 0; ++i)
+        out.put(0);
+}
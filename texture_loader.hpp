@@ -0,0 +1,97 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <cstdlib>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Read-only mapping of a whole file into memory.
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string & path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile & operator=(const MappedFile &) = delete;
+
+    const unsigned char * data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+private:
+    const unsigned char * data_ = nullptr;
+    std::size_t size_ = 0;
+#ifdef _WIN32
+    void * file_ = nullptr;
+    void * mapping_ = nullptr;
+#endif
+};
+
+struct TextureLevel {
+    const unsigned char * data;
+    std::size_t size;
+    int width;
+    int height;
+};
+
+// One texture of a KTX2 or DDS container. Level data points straight into the mapping.
+struct ContainerTexture {
+    GLenum target;
+    GLenum internal_format;
+    GLenum format;
+    GLenum type;
+    bool compressed;
+    int width;
+    int height;
+    int faces;
+    std::vector<std::vector<TextureLevel>> levels; // [level][face]
+};
+
+// RGBA8 pixels decoded with stb_image.
+struct DecodedImage {
+    int width = 0;
+    int height = 0;
+    std::unique_ptr<unsigned char, void (*)(void *)> pixels{nullptr, free};
+};
+
+// Decodes a png/jpg file; safe to call from worker threads.
+DecodedImage decode_image_rgba8(const std::string & path);
+
+// Sampling setup shared by the floor and environment textures.
+struct TextureFiltering {
+    bool mipmaps = true;
+    float anisotropy = 8.f;
+    // Added to the mip level, positive values pick smaller levels.
+    float lod_bias = 0.f;
+};
+
+// Sets the filters, anisotropy and LOD bias of the texture bound to target according to the
+// number of levels it has. Also used to change the filtering of an uploaded texture.
+void apply_texture_filtering(GLenum target, const TextureFiltering & filtering);
+
+// Number of levels in a full mip chain of a width x height texture.
+int mip_level_count(int width, int height);
+
+// Parses all KTX2/DDS images stored back to back in the file, e.g. a textures.pak produced by
+// write_ktx2_rgba8. The file must stay mapped until the textures are uploaded.
+std::vector<ContainerTexture> parse_texture_container(const MappedFile & file);
+
+// Allocates immutable storage with a full mip chain for the texture bound to texture.target
+// (glTexStorage2D where available), uploads the levels present in the container straight
+// from the mapping and generates the missing ones. Sets up trilinear and anisotropic filtering
+// with apply_texture_filtering.
+void upload_container_texture(const ContainerTexture & texture, const TextureFiltering & filtering);
+
+// Same for decoded RGBA8 pixels: one face for GL_TEXTURE_2D, six faces for GL_TEXTURE_CUBE_MAP.
+void upload_rgba8_texture(GLenum target, int width, int height, const std::vector<const unsigned char *> & faces,
+    const TextureFiltering & filtering);
+
+// Appends an uncompressed single-level RGBA8 KTX2 image (1 face for 2D, 6 faces for a cubemap).
+void write_ktx2_rgba8(std::ostream & out, int width, int height, const std::vector<const unsigned char *> & faces);
+
+// Same with levels[level][face] holding every level of a mip chain.
+void write_ktx2_rgba8_mipmapped(std::ostream & out, int width, int height, const std::vector<std::vector<const unsigned char *>> & levels);
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+
+// Lock-free single producer, single consumer hand-off of the latest value. The producer fills
+// back() and publishes it; the consumer picks up the most recently published value and reads
+// it through front() until the next update(). Neither side ever waits for the other, values the
+// consumer was too slow to pick up are overwritten.
+template <typename T>
+class TripleBuffer
+{
+public:
+    // Producer side.
+    T & back() { return buffers_[back_]; }
+    void publish()
+    {
+        back_ = middle_.exchange(back_ | fresh_bit, std::memory_order_acq_rel) & index_mask;
+    }
+
+    // Consumer side. Returns false and keeps the current front() if nothing new was published.
+    bool update()
+    {
+        if (!(middle_.load(std::memory_order_relaxed) & fresh_bit))
+            return false;
+        front_ = middle_.exchange(front_, std::memory_order_acq_rel) & index_mask;
+        return true;
+    }
+    const T & front() const { return buffers_[front_]; }
+
+private:
+    static constexpr int index_mask = 3;
+    static constexpr int fresh_bit = 4;
+
+    std::array<T, 3> buffers_{};
+    int back_ = 0;
+    int front_ = 1;
+    // Index of the buffer in between, plus fresh_bit while it holds a value the consumer hasn't seen.
+    std::atomic<int> middle_ = 2;
+};
@@ -0,0 +1,83 @@
+#include "uniform_buffer.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+void bind_uniform_blocks(GLuint program)
+{
+    // Programs that don't use a block get GL_INVALID_INDEX.
+    if (GLuint index = glGetUniformBlockIndex(program, "Frame"); index != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, index, frame_uniform_binding);
+    if (GLuint index = glGetUniformBlockIndex(program, "Material"); index != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, index, material_uniform_binding);
+    if (GLuint index = glGetUniformBlockIndex(program, "Environment"); index != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, index, environment_uniform_binding);
+}
+
+UniformRing::UniformRing(std::size_t frame_capacity, int frames)
+    : fences_(frames, nullptr)
+{
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    alignment_ = alignment;
+    frame_capacity_ = (frame_capacity + alignment_ - 1) / alignment_ * alignment_;
+    std::size_t size = frame_capacity_ * frames;
+
+    glGenBuffers(1, &buffer_);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+    if (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, size, nullptr, flags);
+        mapping_ = static_cast<unsigned char *>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags));
+        if (!mapping_)
+            throw std::runtime_error("Can't map the uniform buffer");
+    } else {
+        glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    }
+}
+
+UniformRing::~UniformRing()
+{
+    for (GLsync fence : fences_)
+        if (fence)
+            glDeleteSync(fence);
+    if (mapping_) {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+    }
+    glDeleteBuffers(1, &buffer_);
+}
+
+void UniformRing::begin_frame()
+{
+    frame_ = (frame_ + 1) % fences_.size();
+    offset_ = 0;
+    if (GLsync & fence = fences_[frame_]) {
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED)
+            ;
+        glDeleteSync(fence);
+        fence = nullptr;
+    }
+}
+
+void UniformRing::end_frame()
+{
+    if (mapping_)
+        fences_[frame_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void UniformRing::bind(GLuint binding, const void * data, std::size_t size)
+{
+    if (offset_ + size > frame_capacity_)
+        throw std::logic_error("UniformRing: frame capacity exceeded");
+
+    std::size_t offset = frame_ * frame_capacity_ + offset_;
+    if (mapping_) {
+        std::memcpy(mapping_ + offset, data, size);
+    } else {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer_);
+        glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+    }
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, buffer_, offset, size);
+    offset_ += (size + alignment_ - 1) / alignment_ * alignment_;
+}
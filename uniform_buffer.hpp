@@ -0,0 +1,108 @@
+#pragma once
+
+#include <GL/glew.h>
+
+#include <glm/mat4x4.hpp>
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include <cstddef>
+#include <vector>
+
+// Fixed binding points of the uniform blocks declared in shaders/uniforms.glsl.
+enum UniformBinding : GLuint {
+    frame_uniform_binding = 0,
+    material_uniform_binding = 1,
+    environment_uniform_binding = 2,
+};
+
+// std140 mirror of the Frame block: a vec3 followed by a float shares one 16-byte slot.
+struct FrameUniforms {
+    glm::mat4 model;
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 env_view;
+    glm::vec3 camera_position;
+    float time;
+    glm::vec3 sun_direction;
+    float floor_width;
+    glm::vec3 sun_light;
+    float floor_height;
+    glm::vec3 ambient_light;
+    float padding0;
+    glm::vec2 water_scale;
+    glm::vec2 water_offset;
+    glm::mat4 reflection_view_projection;
+    glm::mat4 previous_view_projection;
+    glm::mat4 previous_env_view;
+    glm::vec2 jitter;
+    glm::vec2 render_size;
+    glm::vec2 history_size;
+    float previous_time;
+    float history_weight;
+    float exposure;
+    float bloom_threshold;
+    float bloom_strength;
+    float padding1;
+};
+
+// std140 mirror of the Material block.
+struct MaterialUniforms {
+    float glossiness;
+    float roughness;
+    float padding0[2];
+};
+
+// std140 mirror of the Environment block in shaders/ibl.glsl, written once after the bake.
+struct EnvironmentUniforms {
+    glm::vec4 irradiance_sh[9];
+    float specular_max_lod;
+    float padding0[3];
+};
+
+static_assert(offsetof(FrameUniforms, camera_position) == 256 && offsetof(FrameUniforms, ambient_light) == 304
+    && offsetof(FrameUniforms, water_scale) == 320 && offsetof(FrameUniforms, reflection_view_projection) == 336
+    && offsetof(FrameUniforms, jitter) == 528 && offsetof(FrameUniforms, previous_time) == 552
+    && offsetof(FrameUniforms, exposure) == 560 && sizeof(FrameUniforms) == 576);
+static_assert(sizeof(MaterialUniforms) == 16);
+static_assert(offsetof(EnvironmentUniforms, specular_max_lod) == 144 && sizeof(EnvironmentUniforms) == 160);
+
+// Assigns the Frame, Material and Environment blocks of a freshly linked program to their binding points.
+void bind_uniform_blocks(GLuint program);
+
+// Uniform data of the last few frames in one buffer. With GL 4.4 or ARB_buffer_storage the
+// buffer is persistently mapped and written directly, a fence per frame keeps the CPU from
+// overwriting data the GPU still reads. Otherwise each block is uploaded with glBufferSubData.
+class UniformRing
+{
+public:
+    explicit UniformRing(std::size_t frame_capacity = 64 * 1024, int frames = 3);
+    ~UniformRing();
+
+    UniformRing(const UniformRing &) = delete;
+    UniformRing & operator=(const UniformRing &) = delete;
+
+    void begin_frame();
+    void end_frame();
+
+    // Copies the block into the current frame's region and binds it with glBindBufferRange.
+    void bind(GLuint binding, const void * data, std::size_t size);
+
+    template <typename Block>
+    void bind(GLuint binding, const Block & block)
+    {
+        bind(binding, &block, sizeof(block));
+    }
+
+    bool persistent() const { return mapping_ != nullptr; }
+
+private:
+    GLuint buffer_ = 0;
+    unsigned char * mapping_ = nullptr;
+    std::size_t frame_capacity_;
+    std::size_t alignment_;
+    std::vector<GLsync> fences_;
+    int frame_ = 0;
+    std::size_t offset_ = 0;
+};